@@ -7,13 +7,28 @@
 #define JBSON_BUILDER_HPP
 
 #include <vector>
-#include <system_error>
 
 #include <jbson/element.hpp>
 #include <jbson/document.hpp>
 
 namespace jbson {
 
+namespace detail {
+
+/*!
+ * \brief Whether elements with values of type \p T are written straight into a builder, rather than converted first.
+ *
+ * Specialisations inherit from std::true_type, and have the static member function
+ *
+ *     static void append(std::vector<char>& c, std::experimental::string_view name, const T& val);
+ *
+ * which appends the whole element to \p c, with the strong exception guarantee.
+ * \sa json_text
+ */
+template <typename T> struct in_place_element : std::false_type {};
+
+} // namespace detail
+
 /*!
  * \brief builder provides a simple interface for document construction.
  *
@@ -109,6 +124,19 @@ struct builder {
         return *this;
     }
 
+    /*!
+     * \brief Constructs an element straight into the builder, from a value with an in_place_element specialisation.
+     *
+     * \warning Strong exception guarantee.
+     *
+     * \sa detail::in_place_element
+     */
+    template <typename StringT, typename T>
+    std::enable_if_t<detail::in_place_element<std::decay_t<T>>::value, builder&> emplace(StringT&& name, T&& val) & {
+        detail::in_place_element<std::decay_t<T>>::append(m_elements, std::forward<StringT>(name), val);
+        return *this;
+    }
+
     // rvalue funcs
 
     /*!
@@ -203,18 +231,12 @@ struct array_builder {
 
     template <typename... Args> array_builder& emplace(Args&&... args) & {
         static_assert(sizeof...(Args) > 0, "");
-        std::array<char, std::numeric_limits<decltype(m_count)>::digits10 + 1> int_str;
-        auto n = std::snprintf(int_str.data(), int_str.size(), "%d", m_count);
-        if(n <= 0) {
-            if(errno)
-                BOOST_THROW_EXCEPTION(std::system_error(errno, std::generic_category()));
-            return *this;
-        }
+        detail::index_key_buffer buf;
+        const auto name = detail::index_key(static_cast<int32_t>(m_count), buf);
         auto old_size = m_elements.size();
         try {
-            basic_element<decltype(m_elements)>::write_to_container(
-                m_elements, m_elements.end(), std::experimental::string_view{int_str.data(), static_cast<size_t>(n)},
-                std::forward<Args>(args)...);
+            basic_element<decltype(m_elements)>::write_to_container(m_elements, m_elements.end(), name,
+                                                                    std::forward<Args>(args)...);
             m_count++;
         } catch(...) {
             m_elements.resize(old_size);
@@ -224,6 +246,16 @@ struct array_builder {
         return *this;
     }
 
+    //! Constructs an element straight into the builder. \sa builder::emplace(StringT&&, T&&)
+    template <typename T>
+    std::enable_if_t<detail::in_place_element<std::decay_t<T>>::value, array_builder&> emplace(T&& val) & {
+        detail::index_key_buffer buf;
+        detail::in_place_element<std::decay_t<T>>::append(
+            m_elements, detail::index_key(static_cast<int32_t>(m_count), buf), val);
+        m_count++;
+        return *this;
+    }
+
     // rvalue funcs
 
     template <typename... Args> array_builder&& operator()(Args&&... args) && {
@@ -7,6 +7,7 @@
 #define JBSON_CODECVT_HPP
 
 #include <cassert>
+#include <cstdint>
 
 #include "config.hpp"
 
@@ -61,6 +62,70 @@ template <> struct codecvt<wchar_t> { using type = std::codecvt_utf8<wchar_t>; }
 
 template <typename CharT> using codecvt_t = typename codecvt<CharT>::type;
 
+/*!
+ * \brief Returns the length of the UTF-8 sequence starting at \p first, or 0 if it's malformed.
+ *
+ * Overlong encodings, surrogates and code points beyond U+10FFFF are malformed.
+ */
+template <typename ForwardIterator> size_t utf8_sequence_length(ForwardIterator first, ForwardIterator last) {
+    if(first == last)
+        return 0;
+    const auto lead = static_cast<unsigned char>(*first);
+    if(lead < 0x80)
+        return 1;
+    size_t len;
+    unsigned char lower = 0x80, upper = 0xbf;
+    if(lead < 0xc2)
+        return 0;
+    else if(lead < 0xe0)
+        len = 2;
+    else if(lead < 0xf0) {
+        len = 3;
+        if(lead == 0xe0)
+            lower = 0xa0;
+        else if(lead == 0xed)
+            upper = 0x9f;
+    } else if(lead < 0xf5) {
+        len = 4;
+        if(lead == 0xf0)
+            lower = 0x90;
+        else if(lead == 0xf4)
+            upper = 0x8f;
+    } else
+        return 0;
+
+    ++first;
+    for(size_t i = 1; i < len; ++i, ++first, lower = 0x80, upper = 0xbf) {
+        if(first == last)
+            return 0;
+        const auto c = static_cast<unsigned char>(*first);
+        if(c < lower || c > upper)
+            return 0;
+    }
+    return len;
+}
+
+//! Writes code point \p cp, which must be no greater than U+10FFFF, as UTF-8. Returns the end of the output.
+inline char* encode_utf8(uint32_t cp, char* out) {
+    assert(cp <= 0x10ffff);
+    if(cp < 0x80) {
+        *out++ = static_cast<char>(cp);
+    } else if(cp < 0x800) {
+        *out++ = static_cast<char>(0xc0 | cp >> 6);
+        *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+    } else if(cp < 0x10000) {
+        *out++ = static_cast<char>(0xe0 | cp >> 12);
+        *out++ = static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+    } else {
+        *out++ = static_cast<char>(0xf0 | cp >> 18);
+        *out++ = static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    return out;
+}
+
 } // namespace detail
 } // namespace jbson
 
@@ -0,0 +1,92 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_INDEX_KEY_HPP
+#define JBSON_INDEX_KEY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <experimental/string_view>
+
+#include "./config.hpp"
+
+namespace jbson {
+namespace detail {
+
+//! Number of array indices whose names are precomputed.
+constexpr size_t index_key_table_size = 1000;
+
+//! Names of the first index_key_table_size array indices.
+struct index_key_table {
+    //! Each name, followed by a NUL, as in BSON.
+    char names[index_key_table_size][4];
+    uint8_t sizes[index_key_table_size];
+};
+
+constexpr index_key_table make_index_key_table() {
+    index_key_table table{};
+    for(size_t i = 0; i < index_key_table_size; ++i) {
+        uint8_t n = 0;
+        if(i >= 100)
+            table.names[i][n++] = static_cast<char>('0' + i / 100);
+        if(i >= 10)
+            table.names[i][n++] = static_cast<char>('0' + i / 10 % 10);
+        table.names[i][n++] = static_cast<char>('0' + i % 10);
+        table.sizes[i] = n;
+    }
+    return table;
+}
+
+// a template, so the table can be defined in a header
+template <typename T = void> struct index_keys {
+    static constexpr index_key_table table = make_index_key_table();
+    static constexpr char digit_pairs[] = "0001020304050607080910111213141516171819"
+                                          "2021222324252627282930313233343536373839"
+                                          "4041424344454647484950515253545556575859"
+                                          "6061626364656667686970717273747576777879"
+                                          "8081828384858687888990919293949596979899";
+};
+
+template <typename T> constexpr index_key_table index_keys<T>::table;
+template <typename T> constexpr char index_keys<T>::digit_pairs[];
+
+//! Space to format an index which isn't in the table.
+using index_key_buffer = std::array<char, 12>;
+
+/*!
+ * \brief Returns the name of the array element at index \p idx.
+ *
+ * The name is taken from a precomputed table, or else is formatted into \p buf, two digits at a time.
+ * Either way it's followed by a NUL, so it can be copied to BSON along with its terminator.
+ */
+inline std::experimental::string_view index_key(int32_t idx, index_key_buffer& buf) noexcept {
+    if(idx >= 0 && static_cast<size_t>(idx) < index_key_table_size)
+        return {index_keys<>::table.names[idx], index_keys<>::table.sizes[idx]};
+
+    const auto end = buf.data() + buf.size() - 1;
+    *end = '\0';
+    auto p = end;
+    auto n = idx < 0 ? 0u - static_cast<uint32_t>(idx) : static_cast<uint32_t>(idx);
+    while(n >= 100) {
+        p -= 2;
+        std::memcpy(p, index_keys<>::digit_pairs + n % 100 * 2, 2);
+        n /= 100;
+    }
+    if(n >= 10) {
+        p -= 2;
+        std::memcpy(p, index_keys<>::digit_pairs + n * 2, 2);
+    } else
+        *--p = static_cast<char>('0' + n);
+    if(idx < 0)
+        *--p = '-';
+    return {p, static_cast<size_t>(end - p)};
+}
+
+} // namespace detail
+} // namespace jbson
+
+#endif // JBSON_INDEX_KEY_HPP
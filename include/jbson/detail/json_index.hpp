@@ -0,0 +1,176 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_INDEX_HPP
+#define JBSON_JSON_INDEX_HPP
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+
+#include "./config.hpp"
+#include "./simd.hpp"
+
+namespace jbson {
+namespace detail {
+
+/*!
+ * \brief Positions of the structural characters of contiguous JSON text.
+ *
+ * Built by a vectorised pass over the input before it is parsed.
+ * Records each of `{}[]:,` outside of strings, both quotes of every string, and the first character of every other
+ * token following whitespace or one of the former.
+ * Hence the first non-whitespace character after any whitespace is always indexed, which allows runs of whitespace
+ * to be skipped without inspecting them.
+ * Where AVX2 is available the input is also checked to be well-formed UTF-8, so strings needn't be validated as
+ * they're copied.
+ *
+ * The parser must drop the index if it ever disagrees with it about where a string ends.
+ */
+struct structural_index {
+    //! Inputs smaller than this aren't worth indexing.
+    static constexpr size_t min_input_size = 256;
+
+    structural_index() noexcept = default;
+    // an index is only valid during a single parse, so copies start empty
+    structural_index(const structural_index&) noexcept {
+    }
+    structural_index& operator=(const structural_index&) noexcept {
+        clear();
+        return *this;
+    }
+    structural_index(structural_index&&) noexcept = default;
+    structural_index& operator=(structural_index&&) noexcept = default;
+
+    /*!
+     * \brief Indexes [first, last). Does nothing when the input is too small or too large to index.
+     *
+     * \param check_utf8 Whether to also check the input is well-formed UTF-8, where that's possible.
+     */
+    void build(const char* first, const char* last, bool check_utf8 = true) {
+        clear();
+        const auto len = static_cast<size_t>(last - first);
+        if(len < min_input_size || len >= std::numeric_limits<uint32_t>::max())
+            return;
+#ifdef JBSON_SIMD_AVX2
+        if(simd::has_avx2()) {
+            build_impl<simd::avx2_classifier>(first, len);
+            m_valid_utf8 = check_utf8 && simd::is_valid_utf8_avx2(first, last);
+        } else
+#endif
+#ifdef JBSON_SIMD_SSE2
+            build_impl<simd::sse2_classifier>(first, len);
+#else
+            build_impl<simd::scalar_classifier>(first, len);
+#endif
+    }
+
+    void clear() noexcept {
+        m_base = nullptr;
+        m_size = 0;
+        m_cursor = 0;
+        m_valid_utf8 = false;
+    }
+
+    explicit operator bool() const noexcept {
+        return m_base != nullptr;
+    }
+
+    //! Whether the whole input is known to be well-formed UTF-8. False when unknown.
+    bool valid_utf8() const noexcept {
+        return m_valid_utf8;
+    }
+
+    //! Returns the first indexed position at or after \p p, or the end of input.
+    const char* next(const char* p) noexcept {
+        assert(*this);
+        const auto offset = static_cast<uint32_t>(p - m_base);
+        while(m_positions[m_cursor] < offset)
+            ++m_cursor;
+        return m_base + m_positions[m_cursor];
+    }
+
+  private:
+    //! Marks every character preceded by an odd number of backslashes.
+    static uint64_t escaped_chars(uint64_t backslash, uint64_t& prev_escaped) noexcept {
+        constexpr uint64_t even_bits = 0x5555555555555555ull;
+        backslash &= ~prev_escaped;
+        const uint64_t follows_escape = backslash << 1 | prev_escaped;
+        const uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+        const uint64_t even_sequences = odd_starts + backslash;
+        prev_escaped = even_sequences < odd_starts;
+        return (even_bits ^ (even_sequences << 1)) & follows_escape;
+    }
+
+    template <typename Classifier> void build_impl(const char* first, size_t len) {
+        m_base = first;
+        m_size = 0;
+        // not value-initialised, so pages never written to aren't touched
+        if(m_capacity < len / 4 + 64)
+            reserve(len / 4 + 64);
+
+        uint64_t prev_escaped = 0, prev_in_string = 0, prev_separator = 1;
+        std::array<char, 64> tail;
+        for(size_t offset = 0; offset < len; offset += 64) {
+            // whole blocks of whitespace have nothing to index, and are far cheaper to skip than to classify
+            if(prev_escaped == 0 && simd::is_space(first[offset])) {
+                const auto skipped = static_cast<size_t>(simd::skip_space(first + offset, first + len) - first);
+                if(skipped - offset >= 64) {
+                    offset = skipped & ~size_t{63};
+                    prev_separator = ~prev_in_string & 1;
+                    if(offset >= len)
+                        break;
+                }
+            }
+            simd::json_block b;
+            if(len - offset < 64) {
+                tail.fill(' ');
+                std::copy(first + offset, first + len, tail.data());
+                b = Classifier::classify(tail.data());
+            } else
+                b = Classifier::classify(first + offset);
+
+            const auto quotes = b.quote & ~escaped_chars(b.backslash, prev_escaped);
+            // opening quotes and string contents, but not closing quotes
+            const auto in_string = simd::prefix_xor(quotes) ^ prev_in_string;
+            prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+            const auto op = b.op & ~in_string;
+            const auto separator = (b.space | op | quotes) & ~in_string;
+            const auto token_start = ~(b.space | b.op | b.quote) & ~in_string & (separator << 1 | prev_separator);
+            prev_separator = separator >> 63;
+
+            auto bits = op | quotes | token_start;
+            if(m_capacity < m_size + 65)
+                reserve(m_capacity * 2);
+            while(bits) {
+                m_positions[m_size++] = static_cast<uint32_t>(offset + simd::trailing_zeros(bits));
+                bits &= bits - 1;
+            }
+        }
+        // end of input as a sentinel
+        m_positions[m_size++] = static_cast<uint32_t>(len);
+    }
+
+    void reserve(size_t n) {
+        std::unique_ptr<uint32_t[]> positions{new uint32_t[n]};
+        std::copy(m_positions.get(), m_positions.get() + m_size, positions.get());
+        m_positions = std::move(positions);
+        m_capacity = n;
+    }
+
+    const char* m_base{nullptr};
+    std::unique_ptr<uint32_t[]> m_positions;
+    size_t m_size{0};
+    size_t m_capacity{0};
+    size_t m_cursor{0};
+    bool m_valid_utf8{false};
+};
+
+} // namespace detail
+} // namespace jbson
+
+#endif // JBSON_JSON_INDEX_HPP
@@ -0,0 +1,91 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_SCANNER_HPP
+#define JBSON_JSON_SCANNER_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include "./config.hpp"
+#include "./simd.hpp"
+
+namespace jbson {
+namespace detail {
+
+/*!
+ * \brief Finds where top-level JSON objects and arrays end, without parsing them.
+ *
+ * Only brackets and strings are tracked, so the text between them isn't validated; that's left to json_reader.
+ * Scanning can stop and resume at any character, which allows a value to be delimited across separate buffers.
+ */
+struct value_scanner {
+    //! Whether a value has been started but not yet closed.
+    bool in_value() const noexcept {
+        return m_depth != 0;
+    }
+
+    /*!
+     * \brief Scans [first, last) for the end of the current top-level value.
+     *
+     * If no value is in progress, \p first must point to the `{` or `[` opening one.
+     * \return One past the closing bracket of the value, or \p last if it doesn't close within the range.
+     */
+    const char* scan(const char* first, const char* last) noexcept {
+        assert(in_value() || (first != last && (*first == '{' || *first == '[')));
+        while(first != last) {
+            if(m_in_string) {
+                if(m_escaped) {
+                    m_escaped = false;
+                    ++first;
+                    continue;
+                }
+                bool ascii = true;
+                first = simd::find_string_special(first, last, ascii);
+                if(first == last)
+                    break;
+                if(*first == '"')
+                    m_in_string = false;
+                else if(*first == '\\')
+                    m_escaped = true;
+                ++first;
+                continue;
+            }
+            switch(*first++) {
+                case '"':
+                    m_in_string = true;
+                    break;
+                case '{':
+                case '[':
+                    ++m_depth;
+                    break;
+                case '}':
+                case ']':
+                    if(--m_depth == 0)
+                        return first;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return last;
+    }
+
+    void reset() noexcept {
+        m_depth = 0;
+        m_in_string = false;
+        m_escaped = false;
+    }
+
+  private:
+    size_t m_depth{0};
+    bool m_in_string{false};
+    bool m_escaped{false};
+};
+
+} // namespace detail
+} // namespace jbson
+
+#endif // JBSON_JSON_SCANNER_HPP
@@ -0,0 +1,558 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_SIMD_HPP
+#define JBSON_SIMD_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "./config.hpp"
+#include "./codecvt.hpp"
+
+// Define JBSON_NO_SIMD to build only the portable scalar code paths.
+#if !defined(JBSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JBSON_SIMD_SSE2
+#include <emmintrin.h>
+// AVX2 is selected at runtime, so is only available where functions can be compiled for a target other than the
+// one the rest of the program is compiled for.
+#if defined(__GNUC__) && (BOOST_COMP_GNUC >= BOOST_VERSION_NUMBER(4, 9, 0) || defined(__clang__))
+#define JBSON_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(BOOST_MSVC)
+#include <intrin.h>
+#endif
+
+namespace jbson {
+namespace detail {
+namespace simd {
+
+//! Index of the lowest set bit. \p v must not be zero.
+inline unsigned trailing_zeros(uint64_t v) {
+    assert(v != 0);
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#elif defined(BOOST_MSVC) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return idx;
+#else
+    unsigned n = 0;
+    while(!(v & 1)) {
+        v >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+//! Number of set bits.
+inline unsigned popcount(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (v * 0x0101010101010101ull) >> 56;
+#endif
+}
+
+//! Each output bit is the xor of itself and all lower input bits.
+inline uint64_t prefix_xor(uint64_t v) {
+    v ^= v << 1;
+    v ^= v << 2;
+    v ^= v << 4;
+    v ^= v << 8;
+    v ^= v << 16;
+    v ^= v << 32;
+    return v;
+}
+
+//! Whether the running CPU can execute the AVX2 code paths.
+inline bool has_avx2() {
+#ifdef JBSON_SIMD_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * \brief Bitmasks describing 64 bytes of JSON text, one bit per byte, lowest bit first.
+ *
+ * Whitespace follows detail::isspace, i.e. includes vertical tab and form feed.
+ */
+struct json_block {
+    uint64_t quote;
+    uint64_t backslash;
+    //! Any of `{}[]:,`
+    uint64_t op;
+    uint64_t space;
+};
+
+//! Portable classification of a 64 byte block.
+struct scalar_classifier {
+    static json_block classify(const char* p) {
+        json_block b{0, 0, 0, 0};
+        for(unsigned i = 0; i < 64; i++) {
+            const auto bit = uint64_t{1} << i;
+            switch(p[i]) {
+                case '"':
+                    b.quote |= bit;
+                    break;
+                case '\\':
+                    b.backslash |= bit;
+                    break;
+                case '{':
+                case '}':
+                case '[':
+                case ']':
+                case ':':
+                case ',':
+                    b.op |= bit;
+                    break;
+                case ' ':
+                case '\t':
+                case '\n':
+                case '\v':
+                case '\f':
+                case '\r':
+                    b.space |= bit;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return b;
+    }
+};
+
+#ifdef JBSON_SIMD_SSE2
+struct sse2_classifier {
+    static json_block classify(const char* p) {
+        json_block b{0, 0, 0, 0};
+        for(unsigned i = 0; i < 4; i++) {
+            const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+            const auto quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+            const auto backslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+            const auto braces =
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}')));
+            const auto brackets =
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('[')), _mm_cmpeq_epi8(v, _mm_set1_epi8(']')));
+            const auto separators =
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+            const auto op = _mm_or_si128(_mm_or_si128(braces, brackets), separators);
+            const auto space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                            _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                                          _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1))));
+            b.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(quote))) << (i * 16);
+            b.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(backslash))) << (i * 16);
+            b.op |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(op))) << (i * 16);
+            b.space |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(space))) << (i * 16);
+        }
+        return b;
+    }
+};
+#endif // JBSON_SIMD_SSE2
+
+#ifdef JBSON_SIMD_AVX2
+struct avx2_classifier {
+    // lambdas don't inherit the target attribute, so the comparisons are spelled out
+    __attribute__((target("avx2"))) static json_block classify(const char* p) {
+        json_block b{0, 0, 0, 0};
+        for(unsigned i = 0; i < 2; i++) {
+            const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i * 32));
+            const auto quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+            const auto backslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+            const auto braces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')),
+                                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')));
+            const auto brackets = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')),
+                                                  _mm256_cmpeq_epi8(v, _mm256_set1_epi8(']')));
+            const auto separators = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+            const auto op = _mm256_or_si256(_mm256_or_si256(braces, brackets), separators);
+            const auto space =
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                                 _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v)));
+            b.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(quote))) << (i * 32);
+            b.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(backslash))) << (i * 32);
+            b.op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << (i * 32);
+            b.space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << (i * 32);
+        }
+        return b;
+    }
+};
+#endif // JBSON_SIMD_AVX2
+
+//! Whitespace as detail::isspace.
+inline bool is_space(char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') < 5;
+}
+
+inline const char* skip_space_scalar(const char* first, const char* last) {
+    while(first != last && is_space(*first))
+        ++first;
+    return first;
+}
+
+#ifdef JBSON_SIMD_SSE2
+inline const char* skip_space_sse2(const char* first, const char* last) {
+    const auto space = _mm_set1_epi8(' ');
+    const auto lower = _mm_set1_epi8('\t' - 1);
+    const auto upper = _mm_set1_epi8('\r' + 1);
+    for(; last - first >= 16; first += 16) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const auto ws =
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_and_si128(_mm_cmpgt_epi8(v, lower), _mm_cmplt_epi8(v, upper)));
+        const auto not_ws = static_cast<unsigned>(_mm_movemask_epi8(ws)) ^ 0xffffu;
+        if(not_ws)
+            return first + trailing_zeros(not_ws);
+    }
+    return skip_space_scalar(first, last);
+}
+#endif // JBSON_SIMD_SSE2
+
+#ifdef JBSON_SIMD_AVX2
+__attribute__((target("avx2"))) inline const char* skip_space_avx2(const char* first, const char* last) {
+    const auto space = _mm256_set1_epi8(' ');
+    const auto lower = _mm256_set1_epi8('\t' - 1);
+    const auto upper = _mm256_set1_epi8('\r' + 1);
+    for(; last - first >= 32; first += 32) {
+        const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        const auto ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                        _mm256_and_si256(_mm256_cmpgt_epi8(v, lower), _mm256_cmpgt_epi8(upper, v)));
+        const auto not_ws = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+        if(not_ws)
+            return first + trailing_zeros(not_ws);
+    }
+    return skip_space_sse2(first, last);
+}
+#endif // JBSON_SIMD_AVX2
+
+//! Returns the first non-whitespace character in [first, last), or last.
+inline const char* skip_space(const char* first, const char* last) {
+    // most runs are a single space or a short indent
+    if(last - first < 16)
+        return skip_space_scalar(first, last);
+#ifdef JBSON_SIMD_AVX2
+    if(has_avx2())
+        return skip_space_avx2(first, last);
+#endif
+#ifdef JBSON_SIMD_SSE2
+    return skip_space_sse2(first, last);
+#else
+    return skip_space_scalar(first, last);
+#endif
+}
+
+//! Characters ending a run of plain string content: quote, backslash or control, as detail::iscntrl.
+inline bool is_string_special(char c) {
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x1f;
+}
+
+inline const char* find_string_special_scalar(const char* first, const char* last, bool& ascii) {
+    unsigned char high = 0;
+    for(; first != last && !is_string_special(*first); ++first)
+        high |= static_cast<unsigned char>(*first);
+    ascii = ascii && high < 0x80;
+    return first;
+}
+
+#ifdef JBSON_SIMD_SSE2
+inline const char* find_string_special_sse2(const char* first, const char* last, bool& ascii) {
+    const auto quote = _mm_set1_epi8('"');
+    const auto backslash = _mm_set1_epi8('\\');
+    const auto cntrl = _mm_set1_epi8(0x1e);
+    unsigned high = 0;
+    for(; last - first >= 16; first += 16) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                          _mm_cmpeq_epi8(_mm_min_epu8(v, cntrl), v));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if(mask) {
+            const auto n = trailing_zeros(mask);
+            high |= static_cast<unsigned>(_mm_movemask_epi8(v)) & ((1u << n) - 1);
+            ascii = ascii && high == 0;
+            return first + n;
+        }
+        high |= static_cast<unsigned>(_mm_movemask_epi8(v));
+    }
+    ascii = ascii && high == 0;
+    return find_string_special_scalar(first, last, ascii);
+}
+#endif // JBSON_SIMD_SSE2
+
+#ifdef JBSON_SIMD_AVX2
+__attribute__((target("avx2"))) inline const char* find_string_special_avx2(const char* first, const char* last,
+                                                                           bool& ascii) {
+    const auto quote = _mm256_set1_epi8('"');
+    const auto backslash = _mm256_set1_epi8('\\');
+    const auto cntrl = _mm256_set1_epi8(0x1e);
+    uint32_t high = 0;
+    for(; last - first >= 32; first += 32) {
+        const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        const auto special =
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(v, cntrl), v));
+        const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+        if(mask) {
+            const auto n = trailing_zeros(mask);
+            high |= static_cast<uint32_t>(_mm256_movemask_epi8(v)) & static_cast<uint32_t>((uint64_t{1} << n) - 1);
+            ascii = ascii && high == 0;
+            return first + n;
+        }
+        high |= static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    }
+    ascii = ascii && high == 0;
+    return find_string_special_sse2(first, last, ascii);
+}
+#endif // JBSON_SIMD_AVX2
+
+/*!
+ * \brief Returns the first quote, backslash or control character in [first, last), or last.
+ *
+ * \p ascii is cleared if any character before the one returned isn't ASCII.
+ */
+inline const char* find_string_special(const char* first, const char* last, bool& ascii) {
+    if(last - first < 16)
+        return find_string_special_scalar(first, last, ascii);
+#ifdef JBSON_SIMD_AVX2
+    if(has_avx2())
+        return find_string_special_avx2(first, last, ascii);
+#endif
+#ifdef JBSON_SIMD_SSE2
+    return find_string_special_sse2(first, last, ascii);
+#else
+    return find_string_special_scalar(first, last, ascii);
+#endif
+}
+
+//! Bytes which must be readable from each argument of equal_prefix().
+constexpr size_t equal_prefix_padding = 16;
+
+/*!
+ * \brief Whether the first \p n bytes at \p a and \p b are equal, where \p n is at most 16.
+ *
+ * 16 bytes are read from each, so they can be compared as one vector.
+ */
+inline bool equal_prefix(const char* a, const char* b, size_t n) {
+    assert(n <= equal_prefix_padding);
+#ifdef JBSON_SIMD_SSE2
+    const auto eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+    return (~static_cast<unsigned>(_mm_movemask_epi8(eq)) & ((1u << n) - 1)) == 0;
+#else
+    return std::memcmp(a, b, n) == 0;
+#endif
+}
+
+//! Returns the first non-ASCII character in [first, last), or last.
+inline const char* skip_ascii(const char* first, const char* last) {
+#ifdef JBSON_SIMD_SSE2
+    for(; last - first >= 16; first += 16) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const auto high = static_cast<unsigned>(_mm_movemask_epi8(v));
+        if(high)
+            return first + trailing_zeros(high);
+    }
+#endif // JBSON_SIMD_SSE2
+    while(first != last && static_cast<unsigned char>(*first) < 0x80)
+        ++first;
+    return first;
+}
+
+//! Returns the start of the first malformed UTF-8 sequence in [first, last), or last.
+inline const char* validate_utf8(const char* first, const char* last) {
+    while(first != last) {
+        if(static_cast<unsigned char>(*first) < 0x80) {
+            first = skip_ascii(first, last);
+            continue;
+        }
+        const auto len = utf8_sequence_length(first, last);
+        if(len == 0)
+            break;
+        first += len;
+    }
+    return first;
+}
+
+//! Plain string content which narrows to a single UTF-8 byte: ASCII other than quote, backslash or control.
+template <typename CharT> bool is_plain_ascii(CharT c) {
+    const auto u = static_cast<uint32_t>(c);
+    return u < 0x80 && u >= 0x1f && u != '"' && u != '\\';
+}
+
+template <typename CharT> const CharT* narrow_plain_ascii_scalar(const CharT* first, const CharT* last, char* out) {
+    for(; first != last && is_plain_ascii(*first); ++first)
+        *out++ = static_cast<char>(*first);
+    return first;
+}
+
+#ifdef JBSON_SIMD_SSE2
+inline __m128i plain_ascii_mask_epi16(__m128i v) {
+    const auto ascii = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xff80))), _mm_setzero_si128());
+    const auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(v, _mm_set1_epi16('"')),
+                                                   _mm_cmpeq_epi16(v, _mm_set1_epi16('\\'))),
+                                      _mm_cmplt_epi16(v, _mm_set1_epi16(0x1f)));
+    return _mm_andnot_si128(special, ascii);
+}
+
+inline __m128i plain_ascii_mask_epi32(__m128i v) {
+    const auto ascii = _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(~0x7f)), _mm_setzero_si128());
+    const auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(v, _mm_set1_epi32('"')),
+                                                   _mm_cmpeq_epi32(v, _mm_set1_epi32('\\'))),
+                                      _mm_cmplt_epi32(v, _mm_set1_epi32(0x1f)));
+    return _mm_andnot_si128(special, ascii);
+}
+
+// 16 code units at a time are narrowed with saturating packs, only the leading plain ones being kept
+inline const char16_t* narrow_plain_ascii_sse2(const char16_t* first, const char16_t* last, char* out) {
+    for(; last - first >= 16; first += 16, out += 16) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+        const auto mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_packs_epi16(plain_ascii_mask_epi16(a), plain_ascii_mask_epi16(b))));
+        if(mask != 0xffff)
+            return first + trailing_zeros(~mask);
+    }
+    return narrow_plain_ascii_scalar(first, last, out);
+}
+
+inline const char32_t* narrow_plain_ascii_sse2(const char32_t* first, const char32_t* last, char* out) {
+    for(; last - first >= 16; first += 16, out += 16) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 4));
+        const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 8));
+        const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                         _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_packs_epi16(_mm_packs_epi32(plain_ascii_mask_epi32(a), plain_ascii_mask_epi32(b)),
+                            _mm_packs_epi32(plain_ascii_mask_epi32(c), plain_ascii_mask_epi32(d)))));
+        if(mask != 0xffff)
+            return first + trailing_zeros(~mask);
+    }
+    return narrow_plain_ascii_scalar(first, last, out);
+}
+#endif // JBSON_SIMD_SSE2
+
+/*!
+ * \brief Narrows the run of plain ASCII at the start of [first, last) of UTF-16 or UTF-32 to \p out.
+ *
+ * \p out must have room for `last - first` characters.
+ * \return The end of the run.
+ */
+template <typename CharT> const CharT* narrow_plain_ascii(const CharT* first, const CharT* last, char* out) {
+    static_assert(std::is_same<CharT, char16_t>::value || std::is_same<CharT, char32_t>::value, "");
+#ifdef JBSON_SIMD_SSE2
+    return narrow_plain_ascii_sse2(first, last, out);
+#else
+    return narrow_plain_ascii_scalar(first, last, out);
+#endif
+}
+
+#ifdef JBSON_SIMD_AVX2
+/*!
+ * \brief Whether [first, last) is entirely well-formed UTF-8.
+ *
+ * Classifies each byte by its high nibble and the previous byte's nibbles with table lookups, after Keiser & Lemire,
+ * "Validating UTF-8 In Less Than One Instruction Per Byte".
+ */
+__attribute__((target("avx2"))) inline bool is_valid_utf8_avx2(const char* first, const char* last) {
+    constexpr char too_short = 1 << 0;
+    constexpr char too_long = 1 << 1;
+    constexpr char overlong_3 = 1 << 2;
+    constexpr char too_large = 1 << 3;
+    constexpr char surrogate = 1 << 4;
+    constexpr char overlong_2 = 1 << 5;
+    constexpr char too_large_1000 = 1 << 6;
+    constexpr char overlong_4 = 1 << 6;
+    constexpr char two_conts = static_cast<char>(1 << 7);
+    constexpr char carry = too_short | too_long | two_conts;
+
+    const auto byte_1_high_table = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long, two_conts, two_conts,
+        two_conts, two_conts, too_short | overlong_2, too_short, too_short | overlong_3 | surrogate,
+        too_short | too_large | too_large_1000 | overlong_4));
+    const auto byte_1_low_table = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        carry | overlong_3 | overlong_2 | overlong_4, carry | overlong_2, carry, carry, carry | too_large,
+        carry | too_large | too_large_1000, carry | too_large | too_large_1000, carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000, carry | too_large | too_large_1000, carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000, carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000 | surrogate, carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000));
+    const auto byte_2_high_table = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large, too_short, too_short, too_short, too_short));
+    // non-zero where a block ends part way through a sequence
+    const auto incomplete_max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, char(0xf0 - 1),
+                                                 char(0xe0 - 1), char(0xc0 - 1));
+    const auto nibble = _mm256_set1_epi8(0x0f);
+
+    auto error = _mm256_setzero_si256();
+    auto prev_input = _mm256_setzero_si256();
+    auto prev_incomplete = _mm256_setzero_si256();
+    alignas(32) char tail[32];
+    for(; first < last; first += 32) {
+        const char* p = first;
+        if(last - first < 32) {
+            // padded with ASCII, so a sequence cut short by the end of input is too short
+            std::memset(tail, 0, sizeof(tail));
+            std::memcpy(tail, first, static_cast<size_t>(last - first));
+            p = tail;
+        }
+        const auto input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if(_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_incomplete = _mm256_setzero_si256();
+            prev_input = input;
+            continue;
+        }
+
+        const auto shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+        const auto prev1 = _mm256_alignr_epi8(input, shifted, 15);
+        const auto prev2 = _mm256_alignr_epi8(input, shifted, 14);
+        const auto prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+        const auto byte_1_high =
+            _mm256_shuffle_epi8(byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+        const auto byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, nibble));
+        const auto byte_2_high =
+            _mm256_shuffle_epi8(byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+        const auto special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+        // continuations required by three and four byte leads
+        const auto is_third_byte = _mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xe0 - 0x80)));
+        const auto is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xf0 - 0x80)));
+        const auto must_be_continuation =
+            _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(char(0x80)));
+
+        error = _mm256_or_si256(error, _mm256_xor_si256(must_be_continuation, special_cases));
+        prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        prev_input = input;
+    }
+    error = _mm256_or_si256(error, prev_incomplete);
+    return _mm256_testz_si256(error, error);
+}
+#endif // JBSON_SIMD_AVX2
+
+} // namespace simd
+} // namespace detail
+} // namespace jbson
+
+#endif // JBSON_SIMD_HPP
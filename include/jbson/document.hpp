@@ -23,6 +23,7 @@ JBSON_CLANG_POP_WARNINGS
 #include "detail/traits.hpp"
 #include "element.hpp"
 #include "detail/codecvt.hpp"
+#include "detail/index_key.hpp"
 
 namespace jbson {
 
@@ -669,7 +670,8 @@ class basic_array : public detail::basic_object_base<Container, ElementContainer
     }
 
     const_iterator find(int32_t idx) const {
-        return base::find(std::to_string(idx));
+        detail::index_key_buffer buf;
+        return base::find(detail::index_key(idx, buf));
     }
 
     bool valid(const validity_level lvl = validity_level::bson_size, const bool recurse = true) const {
@@ -677,8 +679,9 @@ class basic_array : public detail::basic_object_base<Container, ElementContainer
         if(ret && (lvl & validity_level::array_indices) == validity_level::array_indices) {
             try {
                 int32_t count{0};
+                detail::index_key_buffer buf;
                 for(auto&& e : *this) {
-                    if(!(ret = (e.name() == std::to_string(count))))
+                    if(!(ret = (e.name() == detail::index_key(count, buf))))
                         break;
 
                     ++count;
@@ -0,0 +1,70 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_BUILDER_HPP
+#define JBSON_JSON_BUILDER_HPP
+
+#include <type_traits>
+#include <vector>
+#include <experimental/string_view>
+
+#include "builder.hpp"
+#include "json_reader.hpp"
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+
+/*!
+ * \brief JSON text to be parsed straight into a builder, as the value of an element.
+ *
+ * The text must be an object or array, which becomes an embedded document or array.
+ * Only refers to the text, which must outlive the call it's passed to.
+ * \sa builder::emplace(StringT&&, T&&), array_builder::emplace(T&&)
+ */
+struct json_text {
+    explicit json_text(std::experimental::string_view text) noexcept : text(text) {
+    }
+
+    std::experimental::string_view text;
+};
+
+namespace detail {
+
+/*!
+ * \brief Appends an element named \p name to \p c, parsing its value from \p json straight into \p c.
+ *
+ * \warning Strong exception guarantee.
+ * \throws json_parse_error When \p json is malformed, or isn't an object or array.
+ */
+inline void append_json_element(std::vector<char>& c, std::experimental::string_view name, json_text json) {
+    const auto first = json.text.data(), last = first + json.text.size();
+    const auto root = simd::skip_space(first, last);
+    const auto type = root != last && *root == '[' ? element_type::array_element : element_type::document_element;
+    const auto old_size = c.size();
+    c.push_back(static_cast<char>(type));
+    c.insert(c.end(), name.begin(), name.end());
+    c.push_back('\0');
+    try {
+        json_reader{}.parse_into(c, first, last);
+    } catch(...) {
+        c.resize(old_size);
+        throw;
+    }
+}
+
+// The document or array is parsed straight into the builder, rather than built separately then copied in.
+template <> struct in_place_element<json_text> : std::true_type {
+    static void append(std::vector<char>& c, std::experimental::string_view name, json_text json) {
+        append_json_element(c, name, json);
+    }
+};
+
+} // namespace detail
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_BUILDER_HPP
@@ -0,0 +1,183 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_FILE_READER_HPP
+#define JBSON_JSON_FILE_READER_HPP
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include "json_reader.hpp"
+
+#if !defined(JBSON_NO_MMAP) && (BOOST_OS_UNIX || BOOST_OS_MACOS || BOOST_OS_BSD)
+#define JBSON_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+
+/*!
+ * \brief Exception thrown when a file can't be read.
+ *
+ * Carries the file's name, and where available the failing system call & its `errno`, as boost::errinfo_file_name,
+ * boost::errinfo_api_function & boost::errinfo_errno.
+ */
+struct json_file_error : jbson_error {
+    //! \copybrief jbson_error::what
+    const char* what() const noexcept override {
+        return "json_file_error";
+    }
+};
+
+namespace detail {
+
+/*!
+ * \brief The contents of a file, read-only.
+ *
+ * Where possible, i.e. on POSIX systems unless JBSON_NO_MMAP is defined, regular files are memory-mapped, so their
+ * contents are never copied.
+ * Anything else, e.g. a pipe, is read into a buffer.
+ */
+struct file_contents {
+    //! \throws json_file_error when the file can't be opened or read.
+    explicit file_contents(const std::string& path);
+    ~file_contents();
+
+    file_contents(const file_contents&) = delete;
+    file_contents& operator=(const file_contents&) = delete;
+
+    const char* begin() const noexcept {
+        return m_data;
+    }
+
+    const char* end() const noexcept {
+        return m_data + m_size;
+    }
+
+  private:
+    const char* m_data{nullptr};
+    size_t m_size{0};
+    bool m_mapped{false};
+    std::vector<char> m_buffer;
+};
+
+#ifdef JBSON_MMAP
+
+inline file_contents::file_contents(const std::string& path) {
+    const auto fail = [&](const char* function) {
+        BOOST_THROW_EXCEPTION(json_file_error{} << boost::errinfo_errno(errno) << boost::errinfo_api_function(function)
+                                                << boost::errinfo_file_name(path));
+    };
+    int fd;
+    do
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    while(fd < 0 && errno == EINTR);
+    if(fd < 0)
+        fail("open");
+
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        const auto size = static_cast<size_t>(st.st_size);
+        const auto p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p != MAP_FAILED) {
+            // it's read once from start to end, so pages can be read well ahead and dropped soon after
+            ::madvise(p, size, MADV_SEQUENTIAL);
+            ::close(fd);
+            m_data = static_cast<const char*>(p);
+            m_size = size;
+            m_mapped = true;
+            return;
+        }
+    }
+
+    // pipes, and files without a known size, are read until they end
+    m_buffer.resize(1 << 16);
+    size_t size = 0;
+    while(true) {
+        if(size == m_buffer.size())
+            m_buffer.resize(m_buffer.size() * 2);
+        const auto n = ::read(fd, m_buffer.data() + size, m_buffer.size() - size);
+        if(n == 0)
+            break;
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            const auto err = errno;
+            ::close(fd);
+            errno = err;
+            fail("read");
+        }
+        size += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    m_buffer.resize(size);
+    m_data = m_buffer.data();
+    m_size = size;
+}
+
+inline file_contents::~file_contents() {
+    if(m_mapped)
+        ::munmap(const_cast<char*>(m_data), m_size);
+}
+
+#else
+
+inline file_contents::file_contents(const std::string& path) {
+    std::ifstream ifs{path, std::ios::binary};
+    if(!ifs)
+        BOOST_THROW_EXCEPTION(json_file_error{} << boost::errinfo_file_name(path));
+    m_buffer.assign(std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{});
+    if(ifs.bad())
+        BOOST_THROW_EXCEPTION(json_file_error{} << boost::errinfo_file_name(path));
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+inline file_contents::~file_contents() {
+}
+
+#endif // JBSON_MMAP
+
+} // namespace detail
+
+/*!
+ * \brief Parses the JSON document in a file.
+ *
+ * The file is parsed straight from a read-only memory mapping where possible, rather than being copied into memory
+ * first. \sa detail::file_contents
+ *
+ * \throws json_file_error when the file can't be read.
+ * \throws json_parse_error As read_json().
+ */
+inline document read_json_file(const std::string& path) {
+    const detail::file_contents contents{path};
+    detail::json_reader reader{};
+    reader.parse(contents.begin(), contents.end());
+
+    return std::move(reader);
+}
+
+//! Parses the JSON array in a file. \sa read_json_file()
+inline array read_json_array_file(const std::string& path) {
+    const detail::file_contents contents{path};
+    detail::json_reader reader{};
+    reader.parse(contents.begin(), contents.end());
+
+    return std::move(reader);
+}
+
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_FILE_READER_HPP
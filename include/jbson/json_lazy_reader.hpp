@@ -0,0 +1,356 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_LAZY_READER_HPP
+#define JBSON_JSON_LAZY_READER_HPP
+
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "json_reader.hpp"
+#include "detail/json_scanner.hpp"
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+
+struct lazy_json_document;
+
+namespace detail {
+
+// Throws for an error at current, located from the start of the input, as a parser would.
+[[noreturn]] inline void throw_lazy_json_error(const char* input, const char* current, const char* last,
+                                               json_error_num num, const char* expected = "") {
+    auto e = json_parse_error{};
+    e << parse_error(num);
+    if(*expected)
+        e << expected_token(expected);
+    add_json_position(e, input, current, last);
+    BOOST_THROW_EXCEPTION(e);
+}
+
+//! Returns one past the closing quote of the string opened at \p first, in the input starting at \p input.
+inline const char* skip_json_string(const char* input, const char* first, const char* last) {
+    assert(first != last && *first == '"');
+    ++first;
+    while(true) {
+        bool ascii = true;
+        first = simd::find_string_special(first, last, ascii);
+        if(first == last)
+            throw_lazy_json_error(input, last, last, json_error_num::unexpected_end_of_range);
+        if(*first == '"')
+            return first + 1;
+        if(*first == '\\' && ++first == last)
+            throw_lazy_json_error(input, last, last, json_error_num::unexpected_end_of_range);
+        ++first;
+    }
+}
+
+/*!
+ * \brief Returns one past the end of the value starting at \p first, without parsing it.
+ *
+ * Objects and arrays are skipped by counting brackets outside of strings, as value_scanner does.
+ * Other values run until the next delimiter or whitespace.
+ */
+inline const char* skip_json_value(const char* input, const char* first, const char* last) {
+    if(first == last)
+        throw_lazy_json_error(input, last, last, json_error_num::unexpected_end_of_range);
+    switch(*first) {
+        case '"':
+            return skip_json_string(input, first, last);
+        case '{':
+        case '[': {
+            value_scanner scanner;
+            const auto end = scanner.scan(first, last);
+            if(scanner.in_value())
+                throw_lazy_json_error(input, last, last, json_error_num::unexpected_end_of_range);
+            return end;
+        }
+        case ',':
+        case ':':
+        case '}':
+        case ']':
+            throw_lazy_json_error(input, first, last, json_error_num::unexpected_token, "value");
+        default:
+            while(first != last && !simd::is_space(*first) && *first != ',' && *first != '}' && *first != ']')
+                ++first;
+            return first;
+    }
+}
+
+//! Takes the decoded name of a member, skipping its value.
+struct member_name_handler {
+    void start_object() noexcept {
+    }
+    void end_object() noexcept {
+    }
+    void start_array() noexcept {
+    }
+    void end_array() noexcept {
+    }
+    void key(std::experimental::string_view key) {
+        name = key.to_string();
+    }
+    void string_value(std::experimental::string_view) noexcept {
+    }
+    void int32_value(int32_t) noexcept {
+    }
+    void int64_value(int64_t) noexcept {
+    }
+    void double_value(double) noexcept {
+    }
+    void bool_value(bool) noexcept {
+    }
+    void null_value() noexcept {
+    }
+    bool skip_value(bool) const noexcept {
+        return true;
+    }
+
+    std::string name;
+};
+
+} // namespace detail
+
+/*!
+ * \brief A member of a lazy_json_document: its name and the extent of its value, neither of which are parsed yet.
+ *
+ * Refers into the text of its document, so is only valid while that is.
+ */
+struct lazy_json_member {
+    //! The member's name as it appears in the input, without quotes, and with any escapes left as they are.
+    std::experimental::string_view raw_name() const noexcept {
+        return {m_name_first + 1, static_cast<size_t>(m_name_last - m_name_first - 2)};
+    }
+
+    //! The member's name, with any escapes decoded.
+    std::string name() const {
+        const auto raw = raw_name();
+        if(raw.find('\\') == raw.npos)
+            return raw.to_string();
+        detail::member_name_handler handler;
+        detail::json_parser{}.parse_member(handler, m_input, m_name_first, m_value_last);
+        return std::move(handler.name);
+    }
+
+    //! The member's value as it appears in the input.
+    std::experimental::string_view raw_value() const noexcept {
+        return {m_value_first, static_cast<size_t>(m_value_last - m_value_first)};
+    }
+
+    //! Whether the value is a JSON object, including any extended json value, e.g. `{"$oid": "..."}`.
+    bool is_object() const noexcept {
+        return *m_value_first == '{';
+    }
+
+    /*!
+     * \brief Returns the value as a lazy_json_document, parsing none of it yet.
+     * \throws incompatible_type_conversion when the value isn't an object.
+     */
+    lazy_json_document lazy_document() const;
+
+    /*!
+     * \brief Parses the member into a BSON element, named as the member.
+     *
+     * Only the member itself is parsed, where it is in the input, and extended json values are recognised as by
+     * read_json().
+     * \throws json_parse_error when the member is malformed, located in the input as a whole.
+     */
+    template <json_parse_policy Policy = json_parse_policy::validating> element to_element() const {
+        detail::basic_json_reader<std::vector<char>, Policy> reader;
+        reader.parse_member(m_input, m_name_first, m_value_last);
+        // the member is the only element of the document parsed
+        const auto& data = reader.data();
+        return element{boost::make_iterator_range(std::next(data.begin(), sizeof(int32_t)), std::prev(data.end()))};
+    }
+
+    //! Parses the member's value as a \p T. \sa to_element(), basic_element::value()
+    template <typename T> T value() const {
+        return to_element().value<T>();
+    }
+
+  private:
+    friend struct lazy_json_document;
+
+    // start of the input, from which errors are located
+    const char* m_input{nullptr};
+    // from the name's opening quote to one past its closing quote
+    const char* m_name_first{nullptr};
+    const char* m_name_last{nullptr};
+    const char* m_value_first{nullptr};
+    const char* m_value_last{nullptr};
+};
+
+/*!
+ * \brief A view of a JSON object which is parsed only as far as its members are looked for.
+ *
+ * Created by read_json_lazy(), and refers into its input, which must outlive it.
+ * Finding or iterating members scans the object from the start, member by member, skipping the values of those passed
+ * over without parsing them, or converting them to BSON.
+ * Values are converted only when asked for, by lazy_json_member::to_element(), or as a whole by to_document().
+ *
+ * Only what is scanned is checked, and then only for its structure, so malformed input may go unnoticed until it's
+ * converted. Malformed structure which is scanned throws json_parse_error, located in the input as a whole.
+ */
+struct lazy_json_document {
+    //! Forward iterator over the members of the object, scanning each as it's reached.
+    struct const_iterator
+        : boost::iterator_facade<const_iterator, const lazy_json_member, boost::forward_traversal_tag> {
+        const_iterator() noexcept = default;
+
+      private:
+        friend struct lazy_json_document;
+        friend class boost::iterator_core_access;
+
+        const_iterator(const char* input, const char* first, const char* last) : m_last(last) {
+            m_member.m_input = input;
+            read_member(first);
+        }
+
+        void read_member(const char* first) {
+            const auto input = m_member.m_input;
+            first = detail::simd::skip_space(first, m_last);
+            if(first == m_last)
+                detail::throw_lazy_json_error(input, m_last, m_last, json_error_num::unexpected_end_of_range);
+            if(*first != '"')
+                detail::throw_lazy_json_error(input, first, m_last, json_error_num::unexpected_token, "string");
+            m_member.m_name_first = first;
+            m_member.m_name_last = first = detail::skip_json_string(input, first, m_last);
+            first = detail::simd::skip_space(first, m_last);
+            if(first == m_last)
+                detail::throw_lazy_json_error(input, m_last, m_last, json_error_num::unexpected_end_of_range);
+            if(*first != ':')
+                detail::throw_lazy_json_error(input, first, m_last, json_error_num::unexpected_token, ":");
+            m_member.m_value_first = first = detail::simd::skip_space(first + 1, m_last);
+            m_member.m_value_last = detail::skip_json_value(input, first, m_last);
+        }
+
+        void increment() {
+            const auto input = m_member.m_input;
+            const auto next = detail::simd::skip_space(m_member.m_value_last, m_last);
+            if(next == m_last)
+                detail::throw_lazy_json_error(input, m_last, m_last, json_error_num::unexpected_end_of_range);
+            if(*next == ',')
+                read_member(next + 1);
+            else if(*next == '}')
+                m_member = lazy_json_member{};
+            else
+                detail::throw_lazy_json_error(input, next, m_last, json_error_num::unexpected_token, ", or }");
+        }
+
+        bool equal(const const_iterator& other) const noexcept {
+            return m_member.m_name_first == other.m_member.m_name_first;
+        }
+
+        const lazy_json_member& dereference() const noexcept {
+            return m_member;
+        }
+
+        lazy_json_member m_member;
+        const char* m_last{nullptr};
+    };
+
+    using iterator = const_iterator;
+    using value_type = lazy_json_member;
+
+    //! \throws json_parse_error when the first member is malformed.
+    const_iterator begin() const {
+        const auto first = detail::simd::skip_space(m_first + 1, m_last);
+        if(first != m_last && *first == '}')
+            return end();
+        return {m_input, first, m_last};
+    }
+
+    const_iterator end() const noexcept {
+        return {};
+    }
+
+    /*!
+     * \brief Returns the first member named \p name, or end().
+     *
+     * Members are scanned only up to the one found. Names without escapes are compared as they appear in the input.
+     * \throws json_parse_error when a member scanned is malformed.
+     */
+    const_iterator find(std::experimental::string_view name) const {
+        const auto last = end();
+        for(auto it = begin(); it != last; ++it) {
+            const auto raw = it->raw_name();
+            if(raw.find('\\') == raw.npos ? raw == name : it->name() == name)
+                return it;
+        }
+        return last;
+    }
+
+    /*!
+     * \brief Parses the whole of the object into a BSON document, as read_json() would.
+     *
+     * For a document returned by read_json_lazy(), that includes checking the input following the object.
+     * \throws json_parse_error when the input is malformed.
+     */
+    template <json_parse_policy Policy = json_parse_policy::validating> document to_document() const {
+        return read_json<Policy>(boost::make_iterator_range(m_first, m_last));
+    }
+
+    explicit operator document() const {
+        return to_document();
+    }
+
+  private:
+    friend struct lazy_json_member;
+    friend lazy_json_document read_json_lazy(const char*, const char*);
+
+    // first points to the object's opening bracket, in the input starting at input
+    lazy_json_document(const char* input, const char* first, const char* last) noexcept
+        : m_input(input), m_first(first), m_last(last) {
+    }
+
+    const char* m_input;
+    const char* m_first;
+    const char* m_last;
+};
+
+inline lazy_json_document lazy_json_member::lazy_document() const {
+    if(!is_object())
+        BOOST_THROW_EXCEPTION(incompatible_type_conversion{});
+    return {m_input, m_value_first, m_value_last};
+}
+
+/*!
+ * \brief Starts reading a JSON object lazily, to find only a few of its members without parsing the rest.
+ *
+ * Nothing past the opening bracket is read until it's asked for. \sa lazy_json_document
+ *
+ * \param first Start of UTF-8 input, which must outlive the returned document.
+ * \param last End of UTF-8 input.
+ * \throws json_parse_error when the input isn't an object.
+ */
+inline lazy_json_document read_json_lazy(const char* first, const char* last) {
+    const auto start = detail::simd::skip_space(first, last);
+    if(start == last)
+        detail::throw_lazy_json_error(first, last, last, json_error_num::unexpected_end_of_range);
+    if(*start != '{')
+        detail::throw_lazy_json_error(first, start, last, json_error_num::invalid_root_element);
+    return {first, start, last};
+}
+
+//! Reads a contiguous range of `char`, e.g. a std::string, lazily. \sa read_json_lazy()
+template <typename ContiguousRange> lazy_json_document read_json_lazy(const ContiguousRange& range) {
+    static_assert(detail::is_iterator_pointer<decltype(std::begin(range))>::value,
+                  "read_json_lazy can only read contiguous ranges");
+    const char* first = boost::empty(range) ? nullptr : std::addressof(*std::begin(range));
+    return read_json_lazy(first, first + boost::size(range));
+}
+
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_LAZY_READER_HPP
@@ -0,0 +1,343 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_LINES_READER_HPP
+#define JBSON_JSON_LINES_READER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "json_reader.hpp"
+#include "detail/json_scanner.hpp"
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+
+//! How the records of a read_json_lines() input are delimited.
+enum class json_lines_format {
+    lines,        //!< One value per line; newline-delimited JSON (NDJSON, JSON Lines).
+    sequence,     //!< One value per record, each prefixed with an ASCII RS; JSON text sequences (RFC 7464).
+    concatenated, //!< Objects and arrays one after another, optionally separated by whitespace.
+};
+
+//! A record of read_json_lines() input which failed to parse.
+struct json_record_error {
+    //! Index of the record among all records of the input.
+    size_t record;
+    //! Offset of the start of the record from the start of the input.
+    size_t offset;
+    //! The error, with line & position relative to the start of the record.
+    json_parse_error error;
+};
+
+//! Result of read_json_lines().
+struct json_lines {
+    //! One document per record, in input order. Records which failed to parse are empty.
+    std::vector<document> documents;
+    //! Records which failed to parse, in input order.
+    std::vector<json_record_error> errors;
+};
+
+//! Result of read_json_lines_arena() & read_json_batch(). Each record's document is stored back-to-back in one buffer.
+struct json_lines_arena {
+    //! Type of a document referring into the arena.
+    using document_type = basic_document<boost::iterator_range<std::vector<char>::const_iterator>>;
+
+    //! Concatenated documents, one per record, in input order. Records which failed to parse are empty.
+    std::vector<char> data;
+    //! Offset of each record's document in data.
+    std::vector<size_t> offsets;
+    //! Records which failed to parse, in input order.
+    std::vector<json_record_error> errors;
+
+    //! Number of records.
+    size_t size() const noexcept {
+        return offsets.size();
+    }
+
+    //! Returns the document of record \p n.
+    document_type operator[](size_t n) const {
+        assert(n < offsets.size());
+        const auto first = std::next(data.begin(), offsets[n]);
+        const auto last = n + 1 < offsets.size() ? std::next(data.begin(), offsets[n + 1]) : data.end();
+        return document_type{boost::make_iterator_range(first, last)};
+    }
+};
+
+namespace detail {
+
+//! Records parsed from one chunk of input, numbered relative to the chunk.
+template <typename Result> struct json_lines_chunk {
+    const char* first;
+    const char* last;
+    Result result;
+    std::exception_ptr exception;
+};
+
+//! Parses [first, last) as the next record of \p result. Nothing is appended when it fails to parse.
+inline void append_record(json_lines& result, json_reader& reader, const char* first, const char* last) {
+    reader.parse(first, last);
+    result.documents.emplace_back(std::move(reader));
+}
+
+// records are parsed straight into the arena, rather than into the reader then copied
+inline void append_record(json_lines_arena& result, json_reader& reader, const char* first, const char* last) {
+    const auto offset = result.data.size();
+    reader.parse_into(result.data, first, last);
+    result.offsets.push_back(offset);
+}
+
+//! Appends an empty document, in place of a record which failed to parse.
+inline void append_empty_record(json_lines& result) {
+    result.documents.emplace_back();
+}
+
+inline void append_empty_record(json_lines_arena& result) {
+    result.offsets.push_back(result.data.size());
+    init_empty(result.data);
+}
+
+inline size_t record_count(const json_lines& result) {
+    return result.documents.size();
+}
+
+inline size_t record_count(const json_lines_arena& result) {
+    return result.offsets.size();
+}
+
+inline void append_records(json_lines& result, json_lines&& chunk) {
+    if(result.documents.empty())
+        result.documents = std::move(chunk.documents);
+    else
+        std::move(chunk.documents.begin(), chunk.documents.end(), std::back_inserter(result.documents));
+}
+
+inline void append_records(json_lines_arena& result, json_lines_arena&& chunk) {
+    if(result.offsets.empty()) {
+        result.data = std::move(chunk.data);
+        result.offsets = std::move(chunk.offsets);
+        return;
+    }
+    const auto n = result.data.size();
+    for(auto offset : chunk.offsets)
+        result.offsets.push_back(offset + n);
+    result.data.insert(result.data.end(), chunk.data.begin(), chunk.data.end());
+}
+
+template <typename Result>
+void parse_record(Result& result, json_reader& reader, const char* input, const char* first, const char* last) {
+    first = simd::skip_space(first, last);
+    if(first == last)
+        return;
+    try {
+        append_record(result, reader, first, last);
+    } catch(json_parse_error& e) {
+        result.errors.push_back({record_count(result), static_cast<size_t>(first - input), std::move(e)});
+        reader.reset();
+        append_empty_record(result);
+    }
+}
+
+//! Returns the end of the record starting at \p first.
+inline const char* record_end(const char* first, const char* last, json_lines_format format) {
+    if(format == json_lines_format::concatenated) {
+        if(first == last || (*first != '{' && *first != '['))
+            // junk is reported as a record of its own, ending where whitespace does
+            return std::find_if(first, last, [](char c) { return simd::is_space(c) || c == '{' || c == '['; });
+        value_scanner scanner;
+        return scanner.scan(first, last);
+    }
+    const auto delim = format == json_lines_format::lines ? '\n' : '\x1e';
+    const auto end = static_cast<const char*>(std::memchr(first, delim, last - first));
+    return end ? end : last;
+}
+
+//! Splits [first, last) into records, parsing each.
+template <typename Result>
+void parse_records(Result& result, const char* input, const char* first, const char* last, json_lines_format format) {
+    json_reader reader;
+    while(first != last) {
+        if(format == json_lines_format::concatenated)
+            first = simd::skip_space(first, last);
+        else if(format == json_lines_format::sequence && *first == '\x1e')
+            ++first;
+        const auto end = record_end(first, last, format);
+        parse_record(result, reader, input, first, end);
+        first = end == last || format != json_lines_format::lines ? end : end + 1;
+    }
+}
+
+//! Splits the input into chunks of whole records, roughly \p size bytes each.
+inline std::vector<std::pair<const char*, const char*>> chunk_records(const char* first, const char* last,
+                                                                     json_lines_format format, size_t size) {
+    std::vector<std::pair<const char*, const char*>> chunks;
+    while(first != last) {
+        auto end = first + std::min<size_t>(size, last - first);
+        if(format == json_lines_format::concatenated) {
+            // values can span lines, so their boundaries can only be found by scanning from the start
+            end = first;
+            while(end != last && static_cast<size_t>(end - first) < size) {
+                end = simd::skip_space(end, last);
+                if(end != last)
+                    end = record_end(end, last, format);
+            }
+        } else if(end != last) {
+            const auto delim = format == json_lines_format::lines ? '\n' : '\x1e';
+            const auto p = static_cast<const char*>(std::memchr(end, delim, last - end));
+            end = p ? p : last;
+        }
+        chunks.emplace_back(first, end);
+        first = end;
+    }
+    return chunks;
+}
+
+template <typename Result>
+Result read_json_lines(const char* first, const char* last, json_lines_format format, unsigned threads) {
+    constexpr size_t min_chunk_size = 1 << 16;
+    if(threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const auto len = static_cast<size_t>(last - first);
+    // several chunks per thread evens out differences in how long they take to parse
+    const auto chunk_size = std::max(min_chunk_size, len / (threads * 8) + 1);
+
+    std::vector<json_lines_chunk<Result>> chunks;
+    for(auto&& c : chunk_records(first, last, format, chunk_size))
+        chunks.push_back({c.first, c.second, {}, {}});
+    threads = static_cast<unsigned>(std::min<size_t>(threads, chunks.size()));
+
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for(auto i = next++; i < chunks.size(); i = next++) {
+            try {
+                parse_records(chunks[i].result, first, chunks[i].first, chunks[i].last, format);
+            } catch(...) {
+                chunks[i].exception = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(work);
+    work();
+    for(auto&& t : workers)
+        t.join();
+
+    Result result;
+    for(auto&& chunk : chunks) {
+        if(chunk.exception)
+            std::rethrow_exception(chunk.exception);
+        const auto n = record_count(result);
+        for(auto&& e : chunk.result.errors) {
+            e.record += n;
+            result.errors.push_back(std::move(e));
+        }
+        append_records(result, std::move(chunk.result));
+    }
+    return result;
+}
+
+} // namespace detail
+
+/*!
+ * \brief Parses a sequence of JSON records, in parallel.
+ *
+ * Each record must be an object or array, as with read_json().
+ * Records are parsed on \p threads threads, or one per hardware thread when 0.
+ * A record which fails to parse doesn't stop the others; its document is left empty and its error is reported in
+ * json_lines::errors.
+ *
+ * \param first Start of UTF-8 input.
+ * \param last End of UTF-8 input.
+ * \param format How records are delimited.
+ * \param threads Number of threads to parse with.
+ */
+inline json_lines read_json_lines(const char* first, const char* last,
+                                  json_lines_format format = json_lines_format::lines, unsigned threads = 0) {
+    return detail::read_json_lines<json_lines>(first, last, format, threads);
+}
+
+//! Parses a contiguous range of `char`, e.g. a std::string, as a sequence of JSON records. \sa read_json_lines()
+template <typename ContiguousRange>
+json_lines read_json_lines(const ContiguousRange& range, json_lines_format format = json_lines_format::lines,
+                           unsigned threads = 0) {
+    static_assert(detail::is_iterator_pointer<decltype(std::begin(range))>::value,
+                  "read_json_lines can only read contiguous ranges");
+    const char* first = boost::empty(range) ? nullptr : std::addressof(*std::begin(range));
+    return read_json_lines(first, first + boost::size(range), format, threads);
+}
+
+/*!
+ * \brief Parses a sequence of JSON records, in parallel, into a single buffer.
+ *
+ * As read_json_lines(), but avoids allocating a buffer per document.
+ */
+inline json_lines_arena read_json_lines_arena(const char* first, const char* last,
+                                              json_lines_format format = json_lines_format::lines,
+                                              unsigned threads = 0) {
+    return detail::read_json_lines<json_lines_arena>(first, last, format, threads);
+}
+
+//! Parses a contiguous range of `char` as a sequence of JSON records into a single buffer. \sa read_json_lines_arena()
+template <typename ContiguousRange>
+json_lines_arena read_json_lines_arena(const ContiguousRange& range,
+                                       json_lines_format format = json_lines_format::lines, unsigned threads = 0) {
+    static_assert(detail::is_iterator_pointer<decltype(std::begin(range))>::value,
+                  "read_json_lines_arena can only read contiguous ranges");
+    const char* first = boost::empty(range) ? nullptr : std::addressof(*std::begin(range));
+    return read_json_lines_arena(first, first + boost::size(range), format, threads);
+}
+
+/*!
+ * \brief Parses a batch of separate JSON documents, e.g. messages, back to back into a single buffer.
+ *
+ * As read_json_lines_arena(), but for inputs which are already separate, so needn't be joined first.
+ * The arena is reserved for the whole batch up front, growing geometrically should that fall short, and each document
+ * is parsed straight into it, so a batch of many small documents allocates its output a few times at most, rather
+ * than once per document.
+ * Every input is a record, including empty ones, which fail to parse; error offsets are from the start of the input.
+ * Inputs are parsed on the calling thread.
+ *
+ * \param inputs Forward range of contiguous ranges of `char`, e.g. a std::vector<std::string>.
+ */
+template <typename ForwardRange> json_lines_arena read_json_batch(const ForwardRange& inputs) {
+    json_lines_arena result;
+    size_t size = 0, count = 0;
+    for(auto&& input : inputs) {
+        size += boost::size(input);
+        ++count;
+    }
+    // BSON is about the size of its JSON, though the smallest, `{}`, grows to 5 bytes
+    result.data.reserve(size + count * 3);
+    result.offsets.reserve(count);
+
+    detail::json_reader reader;
+    for(auto&& input : inputs) {
+        static_assert(detail::is_iterator_pointer<decltype(std::begin(input))>::value,
+                      "read_json_batch can only read contiguous ranges");
+        const char* first = boost::empty(input) ? nullptr : std::addressof(*std::begin(input));
+        try {
+            detail::append_record(result, reader, first, first + boost::size(input));
+        } catch(json_parse_error& e) {
+            result.errors.push_back({result.size(), 0, std::move(e)});
+            reader.reset();
+            detail::append_empty_record(result);
+        }
+    }
+    return result;
+}
+
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_LINES_READER_HPP
@@ -0,0 +1,169 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_PARALLEL_READER_HPP
+#define JBSON_JSON_PARALLEL_READER_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "json_reader.hpp"
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+namespace detail {
+
+//! Elements of one part of an array, parsed speculatively.
+struct array_chunk {
+    const char* first;
+    const char* last;
+    json_reader reader;
+    std::vector<size_t> offsets;
+    bool closed;
+    bool ok;
+};
+
+/*!
+ * \brief Guesses a point between two elements of the array being parsed, somewhere in [first, last).
+ *
+ * Returns the position just after a comma which looks to separate elements like \p element, or nullptr.
+ * Any guess is checked when the array is parsed, so this needn't be right, only usually right.
+ */
+inline const char* find_array_split(const char* first, const char* last, char element) {
+    const auto close = element == '{' ? '}' : element == '[' ? ']' : '\0';
+    const auto begin = first;
+    while(first != last) {
+        const auto comma = static_cast<const char*>(std::memchr(first, ',', last - first));
+        if(!comma)
+            return nullptr;
+        first = comma + 1;
+        if(!close)
+            return first;
+        // containers are only split between ones like "}, {", rather than between their members
+        auto prev = comma;
+        while(prev != begin && simd::is_space(*--prev)) {
+        }
+        const auto next = simd::skip_space(first, last);
+        if(*prev == close && next != last && *next == element)
+            return first;
+    }
+    return nullptr;
+}
+
+//! Appends the elements of \p chunk, named from \p idx, to \p data.
+inline void append_array_chunk(std::vector<char>& data, const array_chunk& chunk, int32_t idx) {
+    const auto& src = chunk.reader.data();
+    for(size_t i = 0; i < chunk.offsets.size(); ++i) {
+        const auto value = std::next(src.begin(), chunk.offsets[i] + 1);
+        const auto end = i + 1 < chunk.offsets.size() ? std::next(src.begin(), chunk.offsets[i + 1]) : src.end();
+        data.push_back(src[chunk.offsets[i]]);
+        index_key_buffer buf;
+        const auto name = index_key(idx++, buf);
+        data.insert(data.end(), name.begin(), name.end() + 1);
+        data.insert(data.end(), value, end);
+    }
+}
+
+} // namespace detail
+
+/*!
+ * \brief Parses a large top-level JSON array on multiple threads.
+ *
+ * The input is split between elements and each part is parsed on its own thread.
+ * Split points are guessed without parsing what precedes them, e.g. a comma may turn out to be inside a string.
+ * Each part's parse confirms the next part's split point; if any guess was wrong, or the input is malformed, the whole
+ * array is parsed again on one thread, as by read_json_array().
+ *
+ * Each thread is given at least 1 MiB of input, as smaller parts aren't worth a thread of their own, so input under
+ * 2 MiB is always parsed on the calling thread alone.
+ *
+ * \param first Start of UTF-8 input.
+ * \param last End of UTF-8 input.
+ * \param threads Most threads to parse with, including the calling thread, or 0 for one per hardware thread.
+ *                Fewer are used when the input is too small to give each 1 MiB of it, or no split is found for one.
+ * \throws json_parse_error As read_json_array().
+ */
+inline array read_json_array_parallel(const char* first, const char* last, unsigned threads = 0) {
+    constexpr size_t min_chunk_size = 1 << 20;
+    if(threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const auto len = static_cast<size_t>(last - first);
+    threads = static_cast<unsigned>(std::min<size_t>(threads, len / min_chunk_size));
+
+    const auto start = detail::simd::skip_space(first, last);
+    const auto element = start != last ? detail::simd::skip_space(start + 1, last) : last;
+    if(threads < 2 || start == last || *start != '[' || element == last || *element == ']')
+        return read_json_array(boost::make_iterator_range(first, last));
+
+    std::vector<detail::array_chunk> chunks;
+    chunks.push_back({element, nullptr, {}, {}, false, false});
+    for(unsigned i = 1; i < threads; ++i) {
+        const auto split = detail::find_array_split(std::max(chunks.back().first, first + len / threads * i),
+                                                    first + len / threads * (i + 1), *element);
+        if(split)
+            chunks.push_back({split, nullptr, {}, {}, false, false});
+    }
+    for(size_t i = 0; i < chunks.size(); ++i)
+        chunks[i].last = i + 1 < chunks.size() ? chunks[i + 1].first : last;
+
+    auto work = [](detail::array_chunk& chunk) {
+        try {
+            chunk.closed = chunk.reader.parse_array_elements(chunk.first, chunk.last, chunk.offsets);
+            chunk.ok = true;
+        } catch(...) {
+        }
+    };
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < chunks.size(); ++i)
+        workers.emplace_back(work, std::ref(chunks[i]));
+    work(chunks.front());
+    for(auto&& t : workers)
+        t.join();
+
+    // the first part starts at a known element, so its success confirms the next split, and so on
+    size_t size = sizeof(int32_t) + 1, count = 0;
+    for(size_t i = 0; i < chunks.size(); ++i) {
+        if(!chunks[i].ok || chunks[i].closed != (i + 1 == chunks.size()))
+            return read_json_array(boost::make_iterator_range(first, last));
+        size += chunks[i].reader.data().size();
+        count += chunks[i].offsets.size();
+    }
+    // each element also gains its index as a name
+    size += count;
+    for(size_t n = 1; n <= count; n *= 10)
+        size += count - n + 1;
+
+    std::vector<char> data;
+    data.reserve(size);
+    data.resize(sizeof(int32_t));
+    int32_t idx = 0;
+    for(auto&& chunk : chunks) {
+        detail::append_array_chunk(data, chunk, idx);
+        idx += static_cast<int32_t>(chunk.offsets.size());
+    }
+    data.push_back('\0');
+    boost::range::copy(detail::native_to_little_endian(static_cast<int32_t>(data.size())), data.begin());
+    return array{std::move(data)};
+}
+
+//! Parses a contiguous range of `char`, e.g. a std::string, as a large JSON array. \sa read_json_array_parallel()
+template <typename ContiguousRange>
+array read_json_array_parallel(const ContiguousRange& range, unsigned threads = 0) {
+    static_assert(detail::is_iterator_pointer<decltype(std::begin(range))>::value,
+                  "read_json_array_parallel can only read contiguous ranges");
+    const char* first = boost::empty(range) ? nullptr : &*std::begin(range);
+    return read_json_array_parallel(first, first + boost::size(range), threads);
+}
+
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_PARALLEL_READER_HPP
@@ -6,10 +6,18 @@
 #ifndef JBSON_JSON_READER_HPP
 #define JBSON_JSON_READER_HPP
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
 #include <type_traits>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <string>
 #include <vector>
+#include <experimental/string_view>
 
 #include "detail/config.hpp"
 
@@ -21,13 +29,15 @@ JBSON_PUSH_DISABLE_DOCUMENTATION_WARNING
 #include <boost/exception/exception.hpp>
 #include <boost/spirit/home/support/iterators/line_pos_iterator.hpp>
 #include <boost/io/ios_state.hpp>
-#include <boost/spirit/home/qi/numeric/numeric_utils.hpp>
-#include <boost/spirit/home/qi/numeric/real.hpp>
+#include <boost/optional.hpp>
 JBSON_CLANG_POP_WARNINGS
 
 #include "document.hpp"
 #include "detail/traits.hpp"
 #include "detail/codecvt.hpp"
+#include "detail/index_key.hpp"
+#include "detail/json_index.hpp"
+#include "detail/json_number.hpp"
 
 JBSON_PUSH_DISABLE_DEPRECATED_WARNING
 
@@ -43,28 +53,768 @@ enum class json_error_num {
     invalid_root_element,
     unexpected_end_of_range,
     unexpected_token,
+    nesting_too_deep,
+};
+
+//! How thoroughly JSON is checked as it's parsed, chosen at compile time.
+enum class json_parse_policy {
+    //! Checks that input is well-formed JSON, throwing json_parse_error where it isn't.
+    validating,
+    /*!
+     * For input known to be well-formed, e.g. validated by whatever produced it.
+     * Skips checking for control characters in strings, malformed UTF-8 & escapes, and the grammar of numbers & of
+     * `true`, `false` and `null`. The output for input which fails those checks is unspecified, although structural
+     * errors, e.g. a missing bracket, are still detected.
+     */
+    trusted
+};
+
+/*!
+ * \brief Why JSON failed to parse, as reported without throwing, e.g. by try_read_json().
+ *
+ * Refers to nothing allocated, so is cheap to report.
+ * The line and column of the error, as added to a json_parse_error, can be recovered from the input at offset.
+ */
+struct json_error {
+    //! Whether there was an error.
+    explicit operator bool() const noexcept {
+        return failed;
+    }
+
+    bool failed{false};
+    json_error_num num{json_error_num::unexpected_token};
+    //! Offset into the input at which the error was found, in units of its characters, e.g. bytes of UTF-8.
+    size_t offset{0};
+    //! What was expected instead, if anything, or an empty string.
+    const char* expected{""};
 };
 
 namespace detail {
 
 using boost::spirit::line_pos_iterator;
 
-struct json_reader {
-    using container_type = std::vector<char>;
-    using range_type = boost::iterator_range<container_type::const_iterator>;
+template <typename Iterator> Iterator base_iterator(const Iterator& it) {
+    return it;
+}
+
+template <typename Iterator> Iterator base_iterator(const line_pos_iterator<Iterator>& it) {
+    return it.base();
+}
+
+//! Names of the members of extended json values, e.g. `{"$oid": "..."}`.
+enum class extended_key {
+    none,
+    binary,
+    type,
+    date,
+    timestamp,
+    regex,
+    options,
+    oid,
+    ref,
+    id,
+    undefined,
+    min_key,
+    max_key,
+    number_long,
+};
+
+//! Matches the name of an extended json member.
+inline extended_key match_extended_key(std::experimental::string_view name) {
+    if(name.size() < 2 || name[0] != '$')
+        return extended_key::none;
+    auto key = extended_key::none;
+    // branch on the first letter, leaving at most a few names to compare
+    switch(name[1]) {
+        case 'b':
+            key = name == "$binary" ? extended_key::binary : extended_key::none;
+            break;
+        case 'd':
+            key = name == "$date" ? extended_key::date : extended_key::none;
+            break;
+        case 'i':
+            key = name == "$id" ? extended_key::id : extended_key::none;
+            break;
+        case 'm':
+            key = name == "$minKey" || name == "$minkey"
+                      ? extended_key::min_key
+                      : name == "$maxKey" || name == "$maxkey" ? extended_key::max_key : extended_key::none;
+            break;
+        case 'n':
+            key = name == "$numberLong" ? extended_key::number_long : extended_key::none;
+            break;
+        case 'o':
+            key = name == "$oid" ? extended_key::oid : name == "$options" ? extended_key::options : extended_key::none;
+            break;
+        case 'r':
+            key = name == "$regex" ? extended_key::regex : name == "$ref" ? extended_key::ref : extended_key::none;
+            break;
+        case 't':
+            key = name == "$type" ? extended_key::type
+                                  : name == "$timestamp" ? extended_key::timestamp : extended_key::none;
+            break;
+        case 'u':
+            key = name == "$undefined" ? extended_key::undefined : extended_key::none;
+            break;
+        default:
+            break;
+    }
+    return key;
+}
+
+//! Whether [first, last) holds at least \p n characters, without stepping past \p last.
+template <typename Iterator>
+bool has_length(Iterator first, const Iterator& last, std::ptrdiff_t n, std::random_access_iterator_tag) {
+    return last - first >= n;
+}
+
+template <typename Iterator>
+bool has_length(Iterator first, const Iterator& last, std::ptrdiff_t n, std::input_iterator_tag) {
+    for(; n > 0 && first != last; --n)
+        ++first;
+    return n == 0;
+}
+
+template <typename Iterator> bool has_length(const Iterator& first, const Iterator& last, std::ptrdiff_t n) {
+    return has_length(first, last, n, typename std::iterator_traits<Iterator>::iterator_category{});
+}
+
+//! Decodes the 24 hex digits of an object id.
+inline bool parse_oid(std::experimental::string_view str, std::array<char, 12>& oid) {
+    if(str.size() != 24)
+        return false;
+    const auto hex = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F'
+                                                                                          ? c - 'A' + 10
+                                                                                          : -1;
+    };
+    for(size_t i = 0; i < 12; ++i) {
+        const auto hi = hex(str[i * 2]), lo = hex(str[i * 2 + 1]);
+        if(hi < 0 || lo < 0)
+            return false;
+        oid[i] = static_cast<char>(hi << 4 | lo);
+    }
+    return true;
+}
+
+//! Decodes padded base64, as RFC 4648, appending the bytes to \p out.
+inline bool decode_base64(std::experimental::string_view str, std::string& out) {
+    if(str.size() % 4 != 0)
+        return false;
+    const auto digit = [](char c) {
+        if(c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if(c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if(c >= '0' && c <= '9')
+            return c - '0' + 52;
+        return c == '+' ? 62 : c == '/' ? 63 : -1;
+    };
+    out.reserve(out.size() + str.size() / 4 * 3);
+    for(size_t i = 0; i < str.size(); i += 4) {
+        // only the last quantum may be padded, by one or two '='
+        const size_t pad = i + 4 == str.size() ? (str[i + 3] == '=') + (str[i + 3] == '=' && str[i + 2] == '=') : 0;
+        uint32_t bits = 0;
+        for(size_t j = 0; j < 4 - pad; ++j) {
+            const auto d = digit(str[i + j]);
+            if(d < 0)
+                return false;
+            bits = bits << 6 | static_cast<uint32_t>(d);
+        }
+        bits <<= 6 * pad;
+        out.push_back(static_cast<char>(bits >> 16));
+        if(pad < 2)
+            out.push_back(static_cast<char>(bits >> 8));
+        if(pad < 1)
+            out.push_back(static_cast<char>(bits));
+    }
+    return true;
+}
+
+using parse_error = boost::error_info<struct err_val_, json_error_num>;
+using expected_token = boost::error_info<struct token_, std::string>;
+using current_line_string = boost::error_info<struct line_, std::string>;
+using line_position = boost::error_info<struct line_pos_, size_t>;
+using line_number = boost::error_info<struct line_num_, size_t>;
+
+//! Adds the line and column of \p current, and the text of its line, to \p e.
+template <typename ForwardIterator>
+void add_json_position(json_parse_error& e, const line_pos_iterator<ForwardIterator>& start,
+                       const line_pos_iterator<ForwardIterator>& current, const line_pos_iterator<ForwardIterator>& last) {
+    using char_type = typename std::iterator_traits<ForwardIterator>::value_type;
+    JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
+    auto begin = boost::spirit::get_line_start(start, current);
+    if(begin != current && begin != last && (*begin == '\n' || *begin == '\r'))
+        std::advance(begin, 1);
+    auto range = boost::range::find_first_of<boost::return_begin_found>(boost::make_iterator_range(begin, last),
+                                                                        boost::as_literal("\n\r"));
+    using cvt_char_type =
+        std::conditional_t<std::is_same<char_type, char>::value, char32_t, char_type>;
+
+    std::basic_string<cvt_char_type> str{range.begin(), range.end()};
+    if(std::is_same<char_type, char>::value)
+        e << current_line_string(boost::lexical_cast<std::string>(range));
+    else {
+#ifndef BOOST_NO_CXX11_HDR_CODECVT
+        try {
+            thread_local std::wstring_convert<std::codecvt_utf8<cvt_char_type>, cvt_char_type> cvt;
+            e << current_line_string(cvt.to_bytes(str));
+        } catch(...)
+#endif // BOOST_NO_CXX11_HDR_CODECVT
+        {
+            auto c = str[boost::spirit::get_line(current)];
+            e << current_line_string(std::to_string((int)c));
+        }
+    }
+    e << line_number(boost::spirit::get_line(current));
+    e << line_position(boost::spirit::get_column(begin, current));
+}
+
+// Lines aren't tracked while parsing, so the position is only recovered, from the start of input, on error.
+template <typename Iterator>
+void add_json_position(json_parse_error& e, const Iterator& start, const Iterator& current, const Iterator& last) {
+    auto pos = line_pos_iterator<Iterator>{start};
+    while(pos.base() != current && pos.base() != last)
+        ++pos;
+    add_json_position(e, line_pos_iterator<Iterator>{start}, pos, line_pos_iterator<Iterator>{last});
+}
+
+/*!
+ * \brief Event-driven JSON parser, reporting what it parses to a handler rather than building anything itself.
+ *
+ * A handler is any type with these member functions, which are called in the order their JSON appears:
+ *
+ *     void start_object();
+ *     void end_object();
+ *     void start_array();
+ *     void end_array();
+ *     void key(std::experimental::string_view);
+ *     void string_value(std::experimental::string_view);
+ *     void int32_value(int32_t);
+ *     void int64_value(int64_t);
+ *     void double_value(double);
+ *     void bool_value(bool);
+ *     void null_value();
+ *
+ * Keys and strings are UTF-8, and are only valid during the call. Escapes are decoded, other than `\u0000`, which is
+ * passed on as is since BSON names can't contain NUL.
+ * Integers are passed to int32_value() when within the range of int32_t, exclusive, otherwise to int64_value().
+ * Other numbers are passed to double_value().
+ *
+ * A handler may throw json_parse_error to reject its input, and the position it was thrown at will be added.
+ * Alternatively, to reject input without throwing, it may have the member function
+ *
+ *     const char* rejected() const noexcept;
+ *
+ * which is checked after each event, and returns what was expected instead of the last, or nullptr.
+ *
+ * A handler may also skip the values of members it doesn't want, with the member function
+ *
+ *     bool skip_value(bool object);
+ *
+ * which is called after each key, with whether its value is an object, and returns whether to skip it.
+ * A skipped value is passed over without being decoded, or reported, and is only checked for closed strings and
+ * balanced brackets, even when validating.
+ *
+ * Containers are parsed iteratively, with those open kept on a stack of their own rather than the call stack, so deep
+ * nesting can't overflow a thread's stack, and is limited by max_depth().
+ * Scratch space, including that stack, is kept between parses, so a reused parser needn't allocate once warmed up.
+ * So are the keys of the last object at each depth, which are checked first when parsing those of the next, as arrays
+ * of objects usually repeat the same keys in the same order.
+ *
+ * Input may also be fed a chunk at a time, with feed(), the parse being suspended between chunks on the same stack.
+ *
+ * \tparam Policy Whether input is checked to be well-formed, or is trusted to be.
+ */
+template <json_parse_policy Policy = json_parse_policy::validating> struct basic_json_parser {
+    basic_json_parser() noexcept = default;
+
+    template <typename Handler, typename ForwardIterator> void parse(Handler&, ForwardIterator, ForwardIterator);
+
+    template <typename Handler, typename ForwardRange_> void parse(Handler& handler, ForwardRange_&& range_) {
+        auto range = boost::as_literal(std::forward<ForwardRange_>(range_));
+        using ForwardRange = decltype(range);
+        JBSON_CONCEPT_ASSERT((boost::ForwardRangeConcept<ForwardRange>));
+        parse(handler, std::begin(range), std::end(range));
+    }
+
+    /*!
+     * \brief Parses without throwing when the input is malformed or rejected by the handler.
+     *
+     * Exceptions thrown by the handler itself still propagate.
+     * \return Whether the input was parsed, otherwise why not is set in \p error.
+     */
+    template <typename Handler, typename ForwardIterator>
+    bool parse(Handler&, ForwardIterator, ForwardIterator, json_error& error);
+
+    template <typename Handler, typename ForwardRange_>
+    bool parse(Handler& handler, ForwardRange_&& range_, json_error& error) {
+        auto range = boost::as_literal(std::forward<ForwardRange_>(range_));
+        using ForwardRange = decltype(range);
+        JBSON_CONCEPT_ASSERT((boost::ForwardRangeConcept<ForwardRange>));
+        return parse(handler, std::begin(range), std::end(range), error);
+    }
+
+    /*!
+     * \brief Parses a run of a top-level array's elements, starting just after its `[` or one of its commas.
+     *
+     * Used to parse separate parts of an array in parallel.
+     * [first, last) must end with a comma following an element, or with the array's closing bracket.
+     * Only the elements are reported, without events for the array around them.
+     * \return Whether the run ended with the closing bracket.
+     */
+    template <typename Handler> bool parse_array_elements(Handler&, const char* first, const char* last);
+
+    /*!
+     * \brief Parses a lone object member, `"name": value`, reporting it as an object of just that member.
+     *
+     * [first, last) must hold only the member, and whitespace. Errors are located from \p input, the start of the
+     * text the member was found in, which may precede \p first.
+     * \throws json_parse_error when the member is malformed.
+     */
+    template <typename Handler> void parse_member(Handler&, const char* input, const char* first, const char* last);
+
+    /*!
+     * \brief Parses the next chunk of a stream of top-level objects and arrays, resuming where the last chunk ended.
+     *
+     * Containers left open are kept on the parser's stack between chunks, and a string, number or literal split
+     * between chunks is the only input buffered, so no value need be held whole.
+     * Stops as soon as a top-level value closes, setting \p closed.
+     * The handler's skip_value() isn't consulted.
+     * After an error, the stream must be reset_stream() before it's fed again.
+     * \return One past the end of the value closed, otherwise \p last.
+     * \throws json_parse_error when the input is malformed, with its position in the stream as a whole.
+     */
+    template <typename Handler> const char* feed(Handler&, const char* first, const char* last, bool& closed);
+
+    /*!
+     * \brief Ends a stream of chunks passed to feed().
+     * \throws json_parse_error when a value has been started but not closed.
+     */
+    void finish();
+
+    //! Discards any partially fed value, ready for a new stream.
+    void reset_stream() noexcept {
+        m_stack.clear();
+        m_stream.token.clear();
+        m_stream = stream_state{std::move(m_stream.token)};
+    }
+
+    //! Number of bytes of a string, number or literal split between chunks, buffered until it's complete.
+    size_t buffered() const noexcept {
+        return m_stream.token.size();
+    }
+
+    static constexpr size_t default_max_depth = 1024;
+
+    /*!
+     * \brief Sets how deeply objects and arrays may be nested, with the root at depth 1.
+     *
+     * Deeper input fails to parse with json_error_num::nesting_too_deep, rather than using ever more memory.
+     */
+    void max_depth(size_t depth) noexcept {
+        m_max_depth = depth;
+    }
+
+    size_t max_depth() const noexcept {
+        return m_max_depth;
+    }
 
-    json_reader() noexcept = default;
+  private:
+    // errors are returned through each function, and thrown only once the parse has unwound, if at all
+    template <typename Handler, typename Iterator>
+    bool parse(Handler&, Iterator, Iterator, json_error*, std::true_type);
+    template <typename Handler, typename Iterator>
+    bool parse(Handler&, Iterator, Iterator, json_error*, std::false_type);
+    template <typename Handler> bool parse_contiguous(Handler&, const char*, const char*, json_error*);
+    template <typename Handler, typename CharT>
+    bool parse_contiguous(Handler&, const CharT*, const CharT*, json_error*);
+    template <typename Handler, typename Iterator> bool parse_root(Handler&, Iterator, Iterator, json_error*);
+    template <typename Iterator, typename Parse> bool parse_from(Iterator&, const Iterator&, json_error*, Parse&&);
+
+    template <typename Iterator> bool fail(json_error_num, const Iterator& current, const char* expected = "");
+
+    template <typename Handler>
+    static auto rejection(const Handler& handler, int) -> decltype(handler.rejected()) {
+        return handler.rejected();
+    }
+    template <typename Handler> static const char* rejection(const Handler&, long) {
+        return nullptr;
+    }
+    template <typename Handler, typename Iterator> bool rejected(const Handler&, const Iterator& current);
+    template <typename Handler>
+    static auto skipping(Handler& handler, bool object, int) -> decltype(handler.skip_value(object)) {
+        return handler.skip_value(object);
+    }
+    template <typename Handler> static bool skipping(Handler&, bool, long) {
+        return false;
+    }
 
-    template <typename ForwardIterator> void parse(ForwardIterator, ForwardIterator);
-    template <typename ForwardIterator>
-    void parse(line_pos_iterator<ForwardIterator>, line_pos_iterator<ForwardIterator>);
+    template <typename Handler, typename Iterator> bool parse_value(Handler&, Iterator&, const Iterator&);
+    template <typename Handler, typename Iterator>
+    bool parse_member_key(Handler&, Iterator&, const Iterator&, size_t depth, size_t idx, bool& skip);
+    template <typename Handler, typename Iterator> bool parse_scalar(Handler&, Iterator&, const Iterator&);
+
+    template <typename Handler, typename Iterator> bool parse_number(Handler&, Iterator&, const Iterator&);
+
+    // streams are parsed a token at a time, with what's expected next kept in m_stream between chunks
+    enum class stream_expect { root, value, value_or_close, key, key_or_close, colon, comma_or_close };
+    enum class stream_token { none, string, key, number, literal };
+
+    template <typename Handler> bool feed_tokens(Handler&, const char*&, const char*, bool& closed);
+    template <typename Handler> bool open_streamed(Handler&, const char*&);
+    template <typename Handler> bool close_streamed(Handler&, const char*&);
+    void end_streamed_value() noexcept;
+    template <typename Handler> bool start_token(Handler&, const char*&, const char*, stream_token);
+    template <typename Handler> bool resume_token(Handler&, const char*&, const char*);
+    template <typename Handler> bool parse_buffered_token(Handler&, stream_token);
+    bool scan_token(const char*&, const char*, stream_token, bool& complete);
+    template <typename Handler> bool parse_token(Handler&, const char*&, const char*, stream_token);
+    template <typename Handler> bool parse_literal(Handler&, const char*&, const char*);
+    void count_lines(const char*, const char*) noexcept;
+    void add_stream_position(json_parse_error&, size_t offset, const char* first, const char* last) const;
+
+    template <typename Iterator>
+    bool parse_string(Iterator&, const Iterator&, std::experimental::string_view&, bool allow_null = true);
+    // only contiguous UTF-8 keys are predicted
+    template <typename Iterator>
+    bool parse_key(Iterator& first, const Iterator& last, std::experimental::string_view& key, size_t, size_t) {
+        return parse_string(first, last, key, false);
+    }
+    bool parse_key(const char*&, const char* const&, std::experimental::string_view&, size_t depth, size_t idx);
+    bool parse_unpredicted_key(const char*&, const char* const&, std::experimental::string_view&, size_t depth,
+                               size_t idx);
+    // only contiguous UTF-8 can be passed on without being copied
+    template <typename Iterator> bool take_plain_string(Iterator&, const Iterator&, std::experimental::string_view&) {
+        return false;
+    }
+    bool take_plain_string(const char*&, const char* const&, std::experimental::string_view&);
+    // only contiguous input can be copied in bulk
+    template <typename Iterator> bool append_plain_run(Iterator&, const Iterator&) {
+        return true;
+    }
+    bool append_plain_run(const char*&, const char* const&);
+    bool append_plain_run(const char16_t*& first, const char16_t* const& last) {
+        return append_utf_run(first, last);
+    }
+    bool append_plain_run(const char32_t*& first, const char32_t* const& last) {
+        return append_utf_run(first, last);
+    }
+    template <typename CharT> bool append_utf_run(const CharT*&, const CharT*);
+
+    template <typename Iterator> bool parse_escape(Iterator&, const Iterator&);
+
+    template <typename Iterator> bool skip_value(Iterator&, const Iterator&);
+    bool skip_value(const char*&, const char* const&);
+    template <typename Iterator> bool skip_string(Iterator&, const Iterator&);
+    bool skip_string(const char*&, const char* const&);
+
+    template <typename Iterator> void skip_space(Iterator&, const Iterator&);
+    void skip_space(const char*&, const char* const&);
+
+    // strings are decoded into a buffer when they can't be passed on straight from the input
+    void append(char c) {
+        m_buffer.push_back(c);
+    }
+    template <typename InputIterator> void append(InputIterator first, InputIterator last) {
+        m_buffer.insert(m_buffer.end(), first, last);
+    }
+
+    template <typename Iterator>
+    json_parse_error make_parse_exception(json_error_num, const Iterator& current, const Iterator& last,
+                                          const std::string& expected = {}) const;
+    json_parse_error make_parse_exception(json_error_num, const std::string& expected = {}) const;
+
+    template <typename Iterator>
+    void add_position(json_parse_error&, const Iterator& current, const Iterator& last) const;
+
+    static constexpr bool validate = Policy == json_parse_policy::validating;
+    // a string is only parsed where it was fed when at least this much input follows it, as a malformed escape may
+    // be read past its closing quote
+    static constexpr size_t stream_padding = 16;
+    // limits the keys remembered of each object, as only small objects are likely to be repeated
+    static constexpr size_t max_shape_size = 4096;
+
+    //! The keys of the last object at some depth, predicting those of the next.
+    struct key_shape {
+        //! Each key as it appears in the input, without escapes, followed by its closing quote, then padding.
+        std::vector<char> bytes;
+        //! Offset of the end of each key in bytes.
+        std::vector<uint32_t> ends;
+    };
+
+    // points to the start of input, whatever its type, during a parse
+    const void* m_start{nullptr};
+    json_error m_error;
+    structural_index m_index;
+    std::vector<char> m_buffer;
+    std::vector<key_shape> m_shapes;
+
+    //! A container being parsed.
+    struct open_container {
+        bool object;
+        //! Number of keys parsed so far, if it's an object, as of when another container was opened in it.
+        uint32_t keys;
+    };
+
+    std::vector<open_container> m_stack;
+    size_t m_max_depth{default_max_depth};
+
+    //! Where feed() left off.
+    struct stream_state {
+        //! Bytes of a token split between chunks, from its start.
+        std::vector<char> token;
+        stream_expect expect{stream_expect::root};
+        //! Kind of the token in token, if any.
+        stream_token pending{stream_token::none};
+        //! Whether token ends in a backslash, escaping what follows.
+        bool escaped{false};
+        //! Whether an error was found in token, rather than in the chunk being fed.
+        bool token_failed{false};
+        //! Offsets into the stream of the chunk being fed, and of token.
+        size_t offset{0};
+        size_t token_offset{0};
+        //! Line, from 1, and offset of the start of that line, at the start of the chunk being fed.
+        size_t line{1};
+        size_t line_start{0};
+    };
+
+    stream_state m_stream;
+};
+
+template <json_parse_policy Policy> constexpr bool basic_json_parser<Policy>::validate;
+template <json_parse_policy Policy> constexpr size_t basic_json_parser<Policy>::max_shape_size;
+template <json_parse_policy Policy> constexpr size_t basic_json_parser<Policy>::default_max_depth;
+template <json_parse_policy Policy> constexpr size_t basic_json_parser<Policy>::stream_padding;
+
+using json_parser = basic_json_parser<>;
+
+/*!
+ * \brief Paths of the members selected by basic_json_reader::project(), as a tree of their names.
+ *
+ * Nodes are referred to by index, the root being 0. The special indices `all` & `none` stand for a member selected
+ * whole, and for one not selected at all.
+ */
+struct json_projection {
+    static constexpr size_t all = std::numeric_limits<size_t>::max();
+    static constexpr size_t none = all - 1;
+
+    //! Replaces the selected paths. Selects everything when \p paths is empty.
+    template <typename ForwardRange> void assign(const ForwardRange& paths);
+
+    //! The node of the root, or all when everything is selected.
+    size_t root() const noexcept {
+        return m_nodes.empty() || m_nodes.front().whole ? all : 0;
+    }
+
+    //! The node of the member \p name of the object at \p node.
+    size_t child(size_t node, std::experimental::string_view name) const noexcept {
+        for(auto c : m_nodes[node].children) {
+            if(m_nodes[c].name == name)
+                return m_nodes[c].whole ? all : c;
+        }
+        return none;
+    }
+
+  private:
+    struct node {
+        std::string name;
+        std::vector<size_t> children;
+        //! Whether the whole member is selected, rather than only some of its own.
+        bool whole;
+    };
+
+    std::vector<node> m_nodes;
+};
+
+template <typename ForwardRange> void json_projection::assign(const ForwardRange& paths) {
+    m_nodes.clear();
+    for(auto&& p : paths) {
+        std::experimental::string_view path{p};
+        if(m_nodes.empty())
+            m_nodes.push_back({{}, {}, false});
+        // JSONPath's root, `$.`, is optional
+        if(!path.empty() && path.front() == '$' && (path.size() == 1 || path[1] == '.'))
+            path.remove_prefix(std::min<size_t>(path.size(), 2));
+        size_t n = 0;
+        while(!path.empty() && !m_nodes[n].whole) {
+            const auto dot = path.find('.');
+            const auto name = path.substr(0, dot);
+            path = dot == path.npos ? std::experimental::string_view{} : path.substr(dot + 1);
+            auto c = child(n, name);
+            if(c == none) {
+                c = m_nodes.size();
+                m_nodes[n].children.push_back(c);
+                m_nodes.push_back({name.to_string(), {}, false});
+            } else if(c == all)
+                break;
+            n = c;
+        }
+        if(!m_nodes[n].whole) {
+            m_nodes[n].whole = true;
+            m_nodes[n].children.clear();
+        }
+    }
+}
+
+/*!
+ * \brief Parses JSON into BSON, stored in a \p Container of `char`.
+ *
+ * Handles the events of a json_parser, also recognising extended json values, e.g. `{"$oid": "..."}`, which are
+ * output as the BSON values they represent.
+ *
+ * A reader can be reused: each parse replaces the output of the last, but keeps its capacity, so parsing many similar
+ * inputs with one reader soon stops allocating.
+ * Output is moved out only by converting an rvalue reader, which releases its buffer.
+ *
+ * \tparam Policy Whether input is checked to be well-formed, or is trusted to be.
+ */
+template <typename Container = std::vector<char>, json_parse_policy Policy = json_parse_policy::validating>
+struct basic_json_reader {
+    using container_type = Container;
+    using range_type = boost::iterator_range<typename container_type::const_iterator>;
+
+    basic_json_reader() noexcept(std::is_nothrow_default_constructible<container_type>::value) = default;
+
+    //! Constructs a reader whose output is allocated by \p alloc.
+    explicit basic_json_reader(const typename container_type::allocator_type& alloc) : m_data(alloc) {
+    }
+
+    template <typename ForwardIterator> void parse(ForwardIterator first, ForwardIterator last) {
+        JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
+        m_data.clear();
+        append_parse(first, last);
+    }
 
     template <typename ForwardRange_> void parse(ForwardRange_&& range_) {
         auto range = boost::as_literal(std::forward<ForwardRange_>(range_));
         using ForwardRange = decltype(range);
         JBSON_CONCEPT_ASSERT((boost::ForwardRangeConcept<ForwardRange>));
-        using line_it = line_pos_iterator<typename boost::range_const_iterator<std::decay_t<ForwardRange>>::type>;
-        parse(line_it{std::begin(range)}, line_it{std::end(range)});
+        parse(std::begin(range), std::end(range));
+    }
+
+    /*!
+     * \brief Parses without throwing when the input is malformed.
+     * \return Whether the input was parsed, otherwise why not is set in \p error, and the output is unspecified.
+     */
+    template <typename ForwardIterator> bool parse(ForwardIterator first, ForwardIterator last, json_error& error) {
+        JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
+        m_data.clear();
+        return append_parse(first, last, &error);
+    }
+
+    template <typename ForwardRange_> bool parse(ForwardRange_&& range_, json_error& error) {
+        auto range = boost::as_literal(std::forward<ForwardRange_>(range_));
+        using ForwardRange = decltype(range);
+        JBSON_CONCEPT_ASSERT((boost::ForwardRangeConcept<ForwardRange>));
+        return parse(std::begin(range), std::end(range), error);
+    }
+
+    /*!
+     * \brief Parses into the end of \p out, rather than into this reader.
+     *
+     * Whatever \p out already contains is kept; the parsed document or array is appended after it, so many can be
+     * parsed into one caller-owned buffer. If parsing fails, \p out is restored to its previous size.
+     */
+    template <typename ForwardIterator> void parse_into(container_type& out, ForwardIterator, ForwardIterator);
+
+    template <typename ForwardRange_> void parse_into(container_type& out, ForwardRange_&& range_) {
+        auto range = boost::as_literal(std::forward<ForwardRange_>(range_));
+        using ForwardRange = decltype(range);
+        JBSON_CONCEPT_ASSERT((boost::ForwardRangeConcept<ForwardRange>));
+        parse_into(out, std::begin(range), std::end(range));
+    }
+
+    /*!
+     * \brief Parses straight into the elements of \p out, without building a whole document first.
+     *
+     * Each top-level element is inserted into \p out as soon as it's been parsed, so only one is ever held in this
+     * reader. Whatever \p out already contains is kept. If parsing fails, elements parsed before the error remain.
+     */
+    template <typename C, typename ForwardIterator>
+    void parse_into(basic_document_set<C>& out, ForwardIterator, ForwardIterator);
+
+    template <typename C, typename ForwardRange_> void parse_into(basic_document_set<C>& out, ForwardRange_&& range_) {
+        auto range = boost::as_literal(std::forward<ForwardRange_>(range_));
+        using ForwardRange = decltype(range);
+        JBSON_CONCEPT_ASSERT((boost::ForwardRangeConcept<ForwardRange>));
+        parse_into(out, std::begin(range), std::end(range));
+    }
+
+    /*!
+     * \brief Parses a run of a top-level array's elements, starting just after its `[` or one of its commas.
+     *
+     * Used to parse separate parts of an array in parallel.
+     * [first, last) must end with a comma following an element, or with the array's closing bracket.
+     * Each element is output as its type followed by its value, without a name, and its offset is added to \p offsets.
+     * \return Whether the run ended with the closing bracket.
+     */
+    bool parse_array_elements(const char* first, const char* last, std::vector<size_t>& offsets);
+
+    /*!
+     * \brief Parses a lone object member, `"name": value`, as a document of just that member.
+     * \sa basic_json_parser::parse_member()
+     */
+    void parse_member(const char* input, const char* first, const char* last) {
+        reset();
+        if(m_reserve_ratio > 0)
+            reserve(static_cast<size_t>(last - first));
+        m_parser.parse_member(*this, input, first, last);
+    }
+
+    //! Discards the output of the last parse, keeping its capacity for the next.
+    void reset() noexcept {
+        m_data.clear();
+        m_frames.clear();
+        m_members.clear();
+        m_rejected = nullptr;
+        m_skip = false;
+    }
+
+    /*!
+     * \brief Limits the output of following parses to the members at \p paths, and the objects containing them.
+     *
+     * Paths are member names separated by dots, e.g. `user.address.city`, optionally prefixed by JSONPath's `$.`.
+     * The member at the end of a path is output whole, and those along it with only their selected members.
+     * Other members aren't output, and their values are skipped by the parser without being decoded, as are those of
+     * members along a path which aren't objects. Where the root is an array, each object in it is projected.
+     * An empty range of paths selects everything again.
+     */
+    template <typename ForwardRange> void project(const ForwardRange& paths) {
+        m_projection.assign(paths);
+    }
+
+    void project(std::initializer_list<std::experimental::string_view> paths) {
+        m_projection.assign(paths);
+    }
+
+    /*!
+     * \brief Sets how much output space to reserve before parsing, per unit of input.
+     *
+     * BSON is usually a little smaller than the JSON it's parsed from, so the default of 1 rarely needs to grow.
+     * 0 disables reserving, leaving the buffer to grow as needed.
+     */
+    void reserve_ratio(double ratio) noexcept {
+        assert(ratio >= 0);
+        m_reserve_ratio = ratio;
+    }
+
+    double reserve_ratio() const noexcept {
+        return m_reserve_ratio;
+    }
+
+    //! Sets how deeply objects and arrays may be nested. \sa basic_json_parser::max_depth()
+    void max_depth(size_t depth) noexcept {
+        m_parser.max_depth(depth);
+    }
+
+    size_t max_depth() const noexcept {
+        return m_parser.max_depth();
+    }
+
+    //! Output of the last parse.
+    const container_type& data() const noexcept {
+        return m_data;
     }
 
     template <typename C> operator basic_document_set<C>() const & {
@@ -85,110 +835,182 @@ struct json_reader {
         return basic_array<C1, C2>{m_data};
     }
 
+    // the buffer was reserved for the input, so is trimmed before being handed on
     template <typename Vec> operator basic_document<container_type, Vec>() && {
         if(m_data.size() < 5)
             return basic_document<container_type, Vec>{};
+        m_data.shrink_to_fit();
         return basic_document<container_type, Vec>{std::move(m_data)};
     }
 
     template <typename Vec> operator basic_array<container_type, Vec>() && {
         if(m_data.size() < 5)
             return basic_array<container_type, Vec>{};
+        m_data.shrink_to_fit();
         return basic_array<container_type, Vec>{std::move(m_data)};
     }
 
   private:
-    template <typename ForwardIterator, typename OutputIterator>
-    OutputIterator parse_document(line_pos_iterator<ForwardIterator>&, const line_pos_iterator<ForwardIterator>&,
-                                  OutputIterator);
-    template <typename ForwardIterator, typename OutputIterator>
-    OutputIterator parse_array(line_pos_iterator<ForwardIterator>&, const line_pos_iterator<ForwardIterator>&,
-                               OutputIterator);
-
-    template <typename ForwardIterator, typename OutputIterator>
-    std::tuple<OutputIterator, element_type> parse_value(line_pos_iterator<ForwardIterator>&,
-                                                         const line_pos_iterator<ForwardIterator>&, OutputIterator);
-
-    template <typename OutputIterator>
-    std::tuple<boost::optional<OutputIterator>, element_type> parse_extended_value(const basic_document<range_type>&,
-                                                                                   OutputIterator);
-
-    template <typename ForwardIterator, typename OutputIterator>
-    OutputIterator parse_string(line_pos_iterator<ForwardIterator>&, const line_pos_iterator<ForwardIterator>&,
-                                OutputIterator);
-
-    template <typename ForwardIterator, typename OutputIterator>
-    OutputIterator parse_name(line_pos_iterator<ForwardIterator>&, const line_pos_iterator<ForwardIterator>&,
-                              OutputIterator, bool allow_null = false);
-
-    template <typename ForwardIterator, typename OutputIterator>
-    OutputIterator parse_escape(line_pos_iterator<ForwardIterator>&, const line_pos_iterator<ForwardIterator>&,
-                                OutputIterator);
-
-    template <typename ForwardIterator, typename OutputIterator>
-    std::tuple<OutputIterator, element_type> parse_number(line_pos_iterator<ForwardIterator>&,
-                                                          const line_pos_iterator<ForwardIterator>&, OutputIterator);
-
-    template <typename ForwardIterator>
-    void skip_space(line_pos_iterator<ForwardIterator>&, const line_pos_iterator<ForwardIterator>&);
-
-    template <typename ForwardIterator>
-    json_parse_error make_parse_exception(json_error_num, const line_pos_iterator<ForwardIterator>& current,
-                                          const line_pos_iterator<ForwardIterator>& last,
-                                          const std::string& expected = {}) const;
-    json_parse_error make_parse_exception(json_error_num, const std::string& expected = {}) const;
+    template <json_parse_policy> friend struct basic_json_parser;
 
-  private:
-    std::shared_ptr<void> m_start;
+    template <typename ForwardIterator> bool append_parse(ForwardIterator, ForwardIterator, json_error* = nullptr);
+    void reserve(size_t input_size);
+
+    // json_parser events
+    void start_object() {
+        start_container(element_type::document_element, false);
+    }
+    void end_object();
+    void start_array() {
+        start_container(element_type::array_element, true);
+    }
+    void end_array() {
+        if(m_set && m_frames.size() == 1)
+            insert_element(m_frames.back().start);
+        close_document(m_frames.back().start);
+        m_frames.pop_back();
+    }
+    void key(std::experimental::string_view);
+    void string_value(std::experimental::string_view str) {
+        begin_value(element_type::string_element);
+        append_value(static_cast<int32_t>(str.size() + 1));
+        append(str.begin(), str.end());
+        append('\0');
+    }
+    void int32_value(int32_t val) {
+        begin_value(element_type::int32_element);
+        append_value(val);
+    }
+    void int64_value(int64_t val) {
+        begin_value(element_type::int64_element);
+        append_value(val);
+    }
+    void double_value(double val) {
+        begin_value(element_type::double_element);
+        append_value(val);
+    }
+    void bool_value(bool val) {
+        begin_value(element_type::boolean_element);
+        append(val);
+    }
+    void null_value() {
+        begin_value(element_type::null_element);
+    }
+    // malformed extended json values are rejected through this rather than by throwing
+    const char* rejected() const noexcept {
+        return m_rejected;
+    }
+    bool skip_value(bool object) {
+        if(m_skip) {
+            m_skip = false;
+            return true;
+        }
+        if(m_path == json_projection::all || object)
+            return false;
+        return drop_member();
+    }
+
+    //! A document or array being output.
+    struct frame {
+        //! Offset of its size.
+        size_t start;
+        //! Offset of its type, or no_type when it's the root or a member of an extended json value.
+        size_t type_idx;
+        //! Index of its first member in m_members, should it be an extended json value.
+        size_t members;
+        //! Number of members or elements so far.
+        int32_t count;
+        bool array;
+        //! Whether it's the value of an element, so could be an extended json value.
+        bool nested;
+        bool extended;
+        //! Node of the projection its members are selected by.
+        size_t path;
+    };
+
+    //! A member of an extended json value, output as just its value until the whole is known.
+    struct extended_member {
+        extended_key key;
+        element_type type;
+        size_t offset;
+    };
+
+    static constexpr size_t no_type = std::numeric_limits<size_t>::max();
+
+    void begin_value(element_type);
+    void start_container(element_type, bool array);
+    bool drop_member();
+    element_type close_extended(const frame&);
+
+    // output is only ever appended to; sizes are back-patched into reserved slots once known
+    void append(char c) {
+        m_data.push_back(c);
+    }
+    template <typename InputIterator> void append(InputIterator first, InputIterator last) {
+        m_data.insert(m_data.end(), first, last);
+    }
+    template <typename T> void append_value(T val) {
+        const auto data = detail::native_to_little_endian(val);
+        append(data.begin(), data.end());
+    }
+    size_t append_size_slot() {
+        const auto idx = m_data.size();
+        m_data.resize(idx + sizeof(int32_t));
+        return idx;
+    }
+    void patch_size_slot(size_t idx, int32_t size) {
+        boost::range::copy(detail::native_to_little_endian(size), std::next(m_data.begin(), idx));
+    }
+    void close_document(size_t start_idx);
+
+    void insert_element(size_t root_idx);
+    template <typename C> static void insert_element(void* set, const char* first, const char* last);
+
+    basic_json_parser<Policy> m_parser;
     container_type m_data;
+    std::vector<frame> m_frames;
+    std::vector<extended_member> m_members;
+    // where the type of the current element is to be written
+    size_t m_type_idx{no_type};
+    // name of the extended json member whose value is next
+    extended_key m_key{extended_key::none};
+    const char* m_rejected{nullptr};
+    std::vector<size_t>* m_offsets{nullptr};
+    // where top-level elements are inserted when parsing into a basic_document_set, and how
+    void* m_set{nullptr};
+    void (*m_insert)(void*, const char*, const char*){nullptr};
+    double m_reserve_ratio{1};
+    json_projection m_projection;
+    // node of the projection selecting the value of the last key, and whether that value is to be skipped instead
+    size_t m_path{json_projection::all};
+    bool m_skip{false};
 };
 
-using parse_error = boost::error_info<struct err_val_, json_error_num>;
-using expected_token = boost::error_info<struct token_, std::string>;
-using current_line_string = boost::error_info<struct line_, std::string>;
-using line_position = boost::error_info<struct line_pos_, size_t>;
-using line_number = boost::error_info<struct line_num_, size_t>;
+template <typename Container, json_parse_policy Policy> constexpr size_t basic_json_reader<Container, Policy>::no_type;
 
-template <typename ForwardIterator>
-json_parse_error
-json_reader::make_parse_exception(json_error_num err, const line_pos_iterator<ForwardIterator>& current,
-                                  const line_pos_iterator<ForwardIterator>& last, const std::string& expected) const {
-    using char_type = typename std::iterator_traits<ForwardIterator>::value_type;
-    JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
-    auto e = make_parse_exception(err, expected);
-    if(m_start) {
-        auto start = *static_cast<line_pos_iterator<ForwardIterator>*>(m_start.get());
-        auto begin = boost::spirit::get_line_start(start, current);
-        if(begin != current && begin != last && (*begin == '\n' || *begin == '\r'))
-            std::advance(begin, 1);
-        auto range = boost::range::find_first_of<boost::return_begin_found>(boost::make_iterator_range(begin, last),
-                                                                            boost::as_literal("\n\r"));
-        using cvt_char_type =
-            std::conditional_t<std::is_same<char_type, container_type::value_type>::value, char32_t, char_type>;
-
-        std::basic_string<cvt_char_type> str{range.begin(), range.end()};
-        if(std::is_same<char_type, container_type::value_type>::value)
-            e << current_line_string(boost::lexical_cast<std::string>(range));
-        else {
-#ifndef BOOST_NO_CXX11_HDR_CODECVT
-            try {
-                thread_local std::wstring_convert<std::codecvt_utf8<cvt_char_type>, cvt_char_type> cvt;
-                e << current_line_string(cvt.to_bytes(str));
-            } catch(...)
-#endif // BOOST_NO_CXX11_HDR_CODECVT
-            {
-                auto c = str[boost::spirit::get_line(current)];
-                e << current_line_string(std::to_string((int)c));
-            }
-        }
-        e << line_number(boost::spirit::get_line(current));
-        e << line_position(boost::spirit::get_column(begin, current));
-    } else
+using json_reader = basic_json_reader<>;
+
+template <json_parse_policy Policy>
+template <typename Iterator>
+void basic_json_parser<Policy>::add_position(json_parse_error& e, const Iterator& current, const Iterator& last) const {
+    if(!m_start)
         std::abort();
+    add_json_position(e, *static_cast<const Iterator*>(m_start), current, last);
+}
+
+template <json_parse_policy Policy>
+template <typename Iterator>
+json_parse_error basic_json_parser<Policy>::make_parse_exception(json_error_num err, const Iterator& current,
+                                                                 const Iterator& last,
+                                                                 const std::string& expected) const {
+    auto e = make_parse_exception(err, expected);
+    add_position(e, current, last);
     return e;
 }
 
-inline json_parse_error json_reader::make_parse_exception(json_error_num err, const std::string& expected) const {
+template <json_parse_policy Policy>
+json_parse_error basic_json_parser<Policy>::make_parse_exception(json_error_num err,
+                                                                 const std::string& expected) const {
     auto e = json_parse_error{};
     e << parse_error(err);
     if(!expected.empty())
@@ -196,369 +1018,348 @@ inline json_parse_error json_reader::make_parse_exception(json_error_num err, co
     return e;
 }
 
-template <typename ForwardIterator> void json_reader::parse(ForwardIterator first, ForwardIterator last) {
-    parse(line_pos_iterator<ForwardIterator>{first}, line_pos_iterator<ForwardIterator>{last});
+template <json_parse_policy Policy>
+template <typename Handler, typename ForwardIterator>
+void basic_json_parser<Policy>::parse(Handler& handler, ForwardIterator first, ForwardIterator last) {
+    JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
+    parse(handler, first, last, nullptr, std::integral_constant<bool, is_iterator_pointer<ForwardIterator>::value>{});
 }
 
-template <typename ForwardIterator>
-void json_reader::parse(line_pos_iterator<ForwardIterator> first, line_pos_iterator<ForwardIterator> last) {
+template <json_parse_policy Policy>
+template <typename Handler, typename ForwardIterator>
+bool basic_json_parser<Policy>::parse(Handler& handler, ForwardIterator first, ForwardIterator last,
+                                      json_error& error) {
     JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
-
-    m_data = container_type{};
-    m_data.reserve(+std::distance(first.base(), last.base()));
-
-    m_start = std::make_shared<line_pos_iterator<ForwardIterator>>(first);
-    skip_space(first, last);
-    if(first == last || *first == '\0')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-    switch(*first) {
-        case '{':
-            parse_document(first, last, m_data.end());
-            break;
-        case '[':
-            parse_array(first, last, m_data.end());
-            break;
-        default:
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::invalid_root_element, first, last));
-    };
-    m_data.shrink_to_fit();
-
-    skip_space(first, last);
-    if(first != last && *first != '\0')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "end of input"));
+    return parse(handler, first, last, &error,
+                 std::integral_constant<bool, is_iterator_pointer<ForwardIterator>::value>{});
 }
 
-template <typename ForwardIterator, typename OutputIterator>
-OutputIterator json_reader::parse_document(line_pos_iterator<ForwardIterator>& first,
-                                           const line_pos_iterator<ForwardIterator>& last, OutputIterator out) {
-    if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-    assert(last != first);
-
-    const auto start_idx = std::distance(m_data.begin(), out);
-
-    assert(out >= m_data.begin() && out <= m_data.end());
-    out = std::next(m_data.insert(out, 4, '\0'), 4);
-
-    if(*first != '{')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "{"));
-    skip_space(++first, last);
-    if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-    if(*first == '}') {
-        ++first;
-
-        assert(out >= m_data.begin() && out <= m_data.end());
-        out = std::next(m_data.insert(out, '\0'));
-
-        int32_t size = std::distance(std::next(m_data.begin(), start_idx), out);
-        if(size != 5)
-            BOOST_THROW_EXCEPTION(invalid_document_size{} << detail::expected_size(5) << detail::actual_size(size));
-        boost::range::copy(detail::native_to_little_endian(size), std::next(m_data.begin(), start_idx));
-        return out;
-    }
+// Contiguous input is parsed straight from memory.
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+bool basic_json_parser<Policy>::parse(Handler& handler, Iterator first_, Iterator last_, json_error* error,
+                                      std::true_type) {
+    using char_type = std::decay_t<typename std::iterator_traits<Iterator>::value_type>;
+    const char_type* first = first_ == last_ ? nullptr : std::addressof(*first_);
+    const char_type* last = first + std::distance(first_, last_);
+    return parse_contiguous(handler, first, last, error);
+}
 
-    while(true) {
-        if(first == last)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
+// UTF-8 is guided by a structural index.
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::parse_contiguous(Handler& handler, const char* first, const char* last,
+                                                 json_error* error) {
+    m_index.build(first, last, validate);
+    const auto ok = parse_root(handler, first, last, error);
+    m_index.clear();
+    return ok;
+}
 
-        assert(out >= m_data.begin() && out <= m_data.end());
-        out = m_data.insert(out, static_cast<char>(element_type::null_element));
+template <json_parse_policy Policy>
+template <typename Handler, typename CharT>
+bool basic_json_parser<Policy>::parse_contiguous(Handler& handler, const CharT* first, const CharT* last,
+                                                 json_error* error) {
+    return parse_root(handler, first, last, error);
+}
 
-        const auto type_idx = std::distance(m_data.begin(), out);
-        ++out;
-        skip_space(first, last);
-        out = parse_name(first, last, out);
-        skip_space(first, last);
+// Other input is parsed through its own iterators.
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+bool basic_json_parser<Policy>::parse(Handler& handler, Iterator first, Iterator last, json_error* error,
+                                      std::false_type) {
+    return parse_root(handler, first, last, error);
+}
 
-        if(*first != ':')
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, ":"));
-        ++first;
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+bool basic_json_parser<Policy>::parse_root(Handler& handler, Iterator first, Iterator last, json_error* error) {
+    return parse_from(first, last, error, [&]() {
         skip_space(first, last);
-        element_type type;
-        std::tie(out, type) = parse_value(first, last, out);
-        m_data[type_idx] = static_cast<char>(type);
+        if(first == last || *first == '\0')
+            return fail(json_error_num::unexpected_end_of_range, first);
+        if(*first != '{' && *first != '[')
+            return fail(json_error_num::invalid_root_element, first);
+        if(!parse_value(handler, first, last))
+            return false;
 
         skip_space(first, last);
-        if(*first == ',') {
-            ++first;
-            continue;
-        }
-        if(*first != '}')
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "}"));
-        else {
-            ++first;
-
-            assert(out >= m_data.begin() && out <= m_data.end());
-            out = std::next(m_data.insert(out, '\0'));
-
-            int32_t size = std::distance(std::next(m_data.begin(), start_idx), out);
-            if(size < 5)
-                BOOST_THROW_EXCEPTION(invalid_document_size{} << detail::expected_size(5) << detail::actual_size(size));
-            boost::range::copy(detail::native_to_little_endian(size), std::next(m_data.begin(), start_idx));
-            return out;
-        }
-    }
+        if(first != last && *first != '\0')
+            return fail(json_error_num::unexpected_token, first, "end of input");
+        return true;
+    });
 }
 
-template <typename ForwardIterator, typename OutputIterator>
-OutputIterator json_reader::parse_array(line_pos_iterator<ForwardIterator>& first,
-                                        const line_pos_iterator<ForwardIterator>& last, OutputIterator out) {
-    if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-    assert(last != first);
-
-    const auto start_idx = std::distance(m_data.begin(), out);
-
-    assert(out >= m_data.begin() && out <= m_data.end());
-    out = std::next(m_data.insert(out, 4, '\0'), 4);
-
-    if(*first != '[')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "["));
-    skip_space(++first, last);
-    if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-    if(*first == ']') {
-        ++first;
-
-        assert(out >= m_data.begin() && out <= m_data.end());
-        out = std::next(m_data.insert(out, '\0'));
-
-        const int32_t size = std::distance(std::next(m_data.begin(), start_idx), out);
-        if(size != 5)
-            BOOST_THROW_EXCEPTION(invalid_document_size{} << detail::expected_size(5) << detail::actual_size(size));
-        boost::range::copy(detail::native_to_little_endian(size), std::next(m_data.begin(), start_idx));
-        return out;
-    }
-
-    int32_t idx{0};
-    while(true) {
-        if(first == last)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-
-        assert(out >= m_data.begin() && out <= m_data.end());
-        out = m_data.insert(out, static_cast<char>(element_type::null_element));
-        auto type_idx = std::distance(m_data.begin(), out);
-        auto sidx = std::to_string(idx++);
-        ++out;
-
-        assert(out >= m_data.begin() && out <= m_data.end());
-        out = m_data.insert(out, sidx.size() + 1, '\0');
-        out = std::next(boost::range::copy(sidx, out));
-        assert(out >= m_data.begin() && out <= m_data.end());
-
-        skip_space(first, last);
+/*
+ * Runs parse with the start of input recorded, from which the offsets and positions of errors are recovered.
+ * Errors in the input are returned in error, or thrown when it's null.
+ */
+template <json_parse_policy Policy>
+template <typename Iterator, typename Parse>
+bool basic_json_parser<Policy>::parse_from(Iterator& first, const Iterator& last, json_error* error, Parse&& parse) {
+    const auto start = first;
+    m_start = &start;
+    m_error = json_error{};
+    m_stack.clear();
+    bool ok;
+    try {
+        ok = parse();
+        if(!ok && !error)
+            BOOST_THROW_EXCEPTION(make_parse_exception(m_error.num, std::next(start, m_error.offset), last,
+                                                       m_error.expected));
+    } catch(json_parse_error& e) {
+        // errors from the handler can't know where they occurred
+        if(!boost::get_error_info<line_number>(e))
+            add_position(e, first, last);
+        m_start = nullptr;
+        m_index.clear();
+        throw;
+    } catch(...) {
+        m_start = nullptr;
+        m_index.clear();
+        throw;
+    }
+    m_start = nullptr;
+    if(!ok) {
+        m_index.clear();
+        *error = m_error;
+    }
+    return ok;
+}
 
-        element_type type;
-        std::tie(out, type) = parse_value(first, last, out);
-        m_data[type_idx] = static_cast<char>(type);
+// Records the first error, at current, for parsing to unwind from; always returns false.
+template <json_parse_policy Policy>
+template <typename Iterator>
+bool basic_json_parser<Policy>::fail(json_error_num num, const Iterator& current, const char* expected) {
+    assert(m_start);
+    m_error.failed = true;
+    m_error.num = num;
+    m_error.offset = static_cast<size_t>(std::distance(*static_cast<const Iterator*>(m_start), current));
+    m_error.expected = expected;
+    return false;
+}
 
-        skip_space(first, last);
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+bool basic_json_parser<Policy>::rejected(const Handler& handler, const Iterator& current) {
+    const char* expected = rejection(handler, 0);
+    return expected && !fail(json_error_num::unexpected_token, current, expected);
+}
 
-        if(*first == ',') {
-            ++first;
-            continue;
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::parse_array_elements(Handler& handler, const char* first, const char* last) {
+    m_index.build(first, last, validate);
+    auto closed = false;
+    parse_from(first, last, nullptr, [&]() {
+        // the elements are nested in the array
+        m_stack.push_back({false, 0});
+        while(true) {
+            skip_space(first, last);
+            if(!parse_value(handler, first, last))
+                return false;
+
+            skip_space(first, last);
+            if(first == last)
+                return fail(json_error_num::unexpected_end_of_range, first);
+            if(*first == ',') {
+                if(++first == last)
+                    return true;
+                continue;
+            }
+            if(*first != ']')
+                return fail(json_error_num::unexpected_token, first, ", or ]");
+            skip_space(++first, last);
+            if(first != last && *first != '\0')
+                return fail(json_error_num::unexpected_token, first, "end of input");
+            closed = true;
+            return true;
         }
-        if(*first != ']')
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, ", or ]"));
-        else {
-            ++first;
+    });
+    m_index.clear();
+    return closed;
+}
 
-            assert(out >= m_data.begin() && out <= m_data.end());
-            out = std::next(m_data.insert(out, '\0'));
+template <json_parse_policy Policy>
+template <typename Handler>
+void basic_json_parser<Policy>::parse_member(Handler& handler, const char* input, const char* first,
+                                             const char* last) {
+    m_index.build(first, last, validate);
+    // parsing runs from first, but offsets are counted from input
+    auto pos = input;
+    parse_from(pos, last, nullptr, [&]() {
+        pos = first;
+        handler.start_object();
+        if(rejected(handler, pos))
+            return false;
+        m_stack.push_back({true, 0});
+        auto skip = false;
+        if(!parse_member_key(handler, pos, last, 0, 0, skip))
+            return false;
+        if(skip ? !skip_value(pos, last) : !parse_value(handler, pos, last))
+            return false;
+        skip_space(pos, last);
+        if(pos != last)
+            return fail(json_error_num::unexpected_token, pos, "end of member");
+        m_stack.pop_back();
+        handler.end_object();
+        return !rejected(handler, pos);
+    });
+    m_index.clear();
+}
 
-            int32_t size = std::distance(std::next(m_data.begin(), start_idx), out);
-            if(size < 5)
-                BOOST_THROW_EXCEPTION(invalid_document_size{} << detail::expected_size(5) << detail::actual_size(size));
-            boost::range::copy(detail::native_to_little_endian(size), std::next(m_data.begin(), start_idx));
-            return out;
+// Values are parsed in a loop, with the containers enclosing the current one kept on m_stack rather than the call
+// stack, so any depth up to max_depth() can be parsed, even on a thread with a small stack.
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+bool basic_json_parser<Policy>::parse_value(Handler& handler, Iterator& first, const Iterator& last) {
+    const auto base = m_stack.size();
+    // the innermost container is kept track of here, and only saved to the stack when another is opened in it
+    auto depth = base;
+    auto object = depth > 0 && m_stack.back().object;
+    uint32_t keys = depth > 0 ? m_stack.back().keys : 0;
+    // whether the handler chose to skip the value of the last key
+    auto skip = false;
+    while(true) {
+        if(first == last)
+            return fail(json_error_num::unexpected_end_of_range, first);
+        auto closing = false;
+        if(skip) {
+            skip = false;
+            if(!skip_value(first, last))
+                return false;
+        } else if(*first == '{' || *first == '[') {
+            if(depth >= m_max_depth)
+                return fail(json_error_num::nesting_too_deep, first);
+            if(depth > 0)
+                m_stack.back().keys = keys;
+            object = *first == '{';
+            keys = 0;
+            m_stack.push_back({object, 0});
+            ++depth;
+            if(object)
+                handler.start_object();
+            else
+                handler.start_array();
+            if(rejected(handler, first))
+                return false;
+            skip_space(++first, last);
+            if(first == last)
+                return fail(json_error_num::unexpected_end_of_range, first);
+            closing = *first == (object ? '}' : ']');
+            if(!closing) {
+                if(object && !parse_member_key(handler, first, last, depth - 1, keys++, skip))
+                    return false;
+                continue;
+            }
+        } else if(!parse_scalar(handler, first, last) || rejected(handler, first))
+            return false;
+
+        // close each container the value ends, until another value is due
+        while(true) {
+            if(!closing) {
+                if(depth == base)
+                    return true;
+                if(first == last)
+                    return fail(json_error_num::unexpected_end_of_range, first);
+                skip_space(first, last);
+                if(first != last && *first == ',') {
+                    skip_space(++first, last);
+                    if(object && !parse_member_key(handler, first, last, depth - 1, keys++, skip))
+                        return false;
+                    break;
+                }
+                if(first == last || *first != (object ? '}' : ']'))
+                    return fail(json_error_num::unexpected_token, first, object ? "}" : ", or ]");
+            }
+            closing = false;
+            if(object)
+                handler.end_object();
+            else
+                handler.end_array();
+            m_stack.pop_back();
+            --depth;
+            object = depth > 0 && m_stack.back().object;
+            keys = depth > 0 ? m_stack.back().keys : 0;
+            if(rejected(handler, first))
+                return false;
+            ++first;
         }
     }
 }
 
-template <typename ForwardIterator, typename OutputIterator>
-std::tuple<OutputIterator, element_type> json_reader::parse_value(line_pos_iterator<ForwardIterator>& first,
-                                                                  const line_pos_iterator<ForwardIterator>& last,
-                                                                  OutputIterator out) {
+// Parses the key at index idx of the innermost object, at depth, and the colon after it, then asks the handler whether
+// to skip the value.
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+BOOST_FORCEINLINE bool basic_json_parser<Policy>::parse_member_key(Handler& handler, Iterator& first,
+                                                                   const Iterator& last, size_t depth, size_t idx,
+                                                                   bool& skip) {
     if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
+        return fail(json_error_num::unexpected_end_of_range, first);
+    skip_space(first, last);
+    std::experimental::string_view key;
+    if(!parse_key(first, last, key, depth, idx))
+        return false;
+    handler.key(key);
+    if(rejected(handler, first))
+        return false;
+    skip_space(first, last);
+    if(first == last || *first != ':')
+        return fail(json_error_num::unexpected_token, first, ":");
+    skip_space(++first, last);
+    skip = skipping(handler, first != last && *first == '{', 0);
+    return true;
+}
+
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+BOOST_FORCEINLINE bool basic_json_parser<Policy>::parse_scalar(Handler& handler, Iterator& first,
+                                                               const Iterator& last) {
     assert(last != first);
-    auto type = element_type::null_element;
     switch(*first) {
-        case '"':
-            type = element_type::string_element;
-            out = parse_string(first, last, out);
-            break;
-        case '[':
-            type = element_type::array_element;
-            out = parse_array(first, last, out);
-            break;
+        case '"': {
+            std::experimental::string_view str;
+            if(!parse_string(first, last, str))
+                return false;
+            handler.string_value(str);
+        } break;
         case 'f':
-            type = element_type::boolean_element;
-            if(boost::equal(boost::as_literal("false"), boost::make_iterator_range(first, std::next(first, 5)),
-                            [](char a, auto b) { return b == static_cast<decltype(b)>(a); })) {
-                assert(out >= m_data.begin() && out <= m_data.end());
-                out = std::next(m_data.insert(out, false));
+            if(!detail::has_length(first, last, 5))
+                return fail(json_error_num::unexpected_end_of_range, last);
+            if(!validate || boost::equal(boost::as_literal("false"),
+                                         boost::make_iterator_range(first, std::next(first, 5)),
+                                         [](char a, auto b) { return b == static_cast<decltype(b)>(a); })) {
                 std::advance(first, 5);
+                handler.bool_value(false);
                 break;
             }
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "false"));
+            return fail(json_error_num::unexpected_token, first, "false");
         case 'n':
-            type = element_type::null_element;
-            if(!boost::equal(boost::as_literal("null"), boost::make_iterator_range(first, std::next(first, 4)),
-                             [](char a, auto b) { return b == static_cast<decltype(b)>(a); }))
-                BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "null"));
+            if(!detail::has_length(first, last, 4))
+                return fail(json_error_num::unexpected_end_of_range, last);
+            if(validate && !boost::equal(boost::as_literal("null"),
+                                         boost::make_iterator_range(first, std::next(first, 4)),
+                                         [](char a, auto b) { return b == static_cast<decltype(b)>(a); }))
+                return fail(json_error_num::unexpected_token, first, "null");
             std::advance(first, 4);
+            handler.null_value();
             break;
         case 't':
-            type = element_type::boolean_element;
-            if(boost::equal(boost::as_literal("true"), boost::make_iterator_range(first, std::next(first, 4)),
-                            [](char a, auto b) { return b == static_cast<decltype(b)>(a); })) {
-                assert(out >= m_data.begin() && out <= m_data.end());
-                out = std::next(m_data.insert(out, true));
+            if(!detail::has_length(first, last, 4))
+                return fail(json_error_num::unexpected_end_of_range, last);
+            if(!validate || boost::equal(boost::as_literal("true"),
+                                         boost::make_iterator_range(first, std::next(first, 4)),
+                                         [](char a, auto b) { return b == static_cast<decltype(b)>(a); })) {
                 std::advance(first, 4);
+                handler.bool_value(true);
                 break;
             }
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "true"));
-        case '{': {
-            auto idx = std::distance(m_data.begin(), out);
-            auto r = parse_document(first, last, out);
-
-            basic_document<range_type> doc{std::next(m_data.begin(), idx), r};
-            assert(std::distance(std::next(m_data.begin(), idx), r) >= 5);
-            assert(doc.size() >= 5);
-
-            std::experimental::string_view name;
-            const auto it = doc.begin();
-            if(it != doc.end())
-                name = it->name();
-            if(!name.empty() && name[0] == '$') {
-                boost::optional<OutputIterator> o_out;
-                std::tie(o_out, type) = parse_extended_value(doc, std::next(m_data.begin(), idx));
-                if(o_out) {
-                    out = *o_out;
-                    m_data.resize(std::distance(m_data.begin(), out));
-                    break;
-                }
-            }
-            type = element_type::document_element;
-            using std::swap;
-            swap(out, r);
-        } break;
+            return fail(json_error_num::unexpected_token, first, "true");
         default:
-            std::tie(out, type) = parse_number(first, last, out);
+            return parse_number(handler, first, last);
     }
-    if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
-    return std::make_tuple(out, type);
-}
-
-template <typename OutputIterator>
-std::tuple<boost::optional<OutputIterator>, element_type>
-json_reader::parse_extended_value(const basic_document<range_type>& doc, OutputIterator out) {
-    if(doc.size() < 5)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "extended json value")
-                              << detail::expected_size(5) << detail::actual_size(doc.size()));
-    auto type = element_type::null_element;
-    const auto name = doc.begin()->name();
-    if(name == "$binary" || name == "$type") {
-        if(doc.size() != 2)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "binary element"));
-        type = element_type::binary_element;
-        // TODO: implement binary value
-    } else if(name == "$date") {
-        if(doc.size() != 1 ||
-           (doc.begin()->type() != element_type::int32_element && doc.begin()->type() != element_type::int64_element))
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "date element"));
-        using DateT = detail::ElementTypeMap<element_type::date_element, element::container_type>;
-        if(doc.begin()->type() == element_type::int32_element)
-            detail::serialise(m_data, out, static_cast<DateT>(get<element_type::int32_element>(*doc.begin())));
-        else if(doc.begin()->type() == element_type::int64_element)
-            detail::serialise(m_data, out, static_cast<DateT>(get<element_type::int64_element>(*doc.begin())));
-        else
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "date element"));
-        type = element_type::date_element;
-    } else if(name == "$timestamp") {
-        if(doc.size() != 1)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "timestamp element"));
-        type = element_type::timestamp_element;
-        // TODO: implement timestamp
-    } else if(name == "$regex" || name == "$options") {
-        if(doc.size() != 2)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "regex element"));
-        auto it = doc.find("$regex");
-        if(it == doc.end() || it->type() != element_type::string_element)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "regex element"));
-        auto re = get<element_type::string_element>(*it);
-        it = doc.find("$options");
-        if(it == doc.end() || it->type() != element_type::string_element)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "regex element"));
-        auto options = get<element_type::string_element>(*it);
-
-        type = element_type::regex_element;
-        detail::serialise(m_data, out, std::make_tuple(re, options));
-    } else if(name == "$oid") {
-        if(doc.size() != 40 || doc.begin()->type() != element_type::string_element)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "oid element"));
-        auto str = get<element_type::string_element>(*doc.begin());
-        if(str.size() != 24)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "oid element"));
-        std::array<char, 12> oid;
-        for(auto i = 0; i < 24; i += 2)
-            oid[i / 2] = static_cast<char>(std::stoi(boost::lexical_cast<std::string>(str.substr(i, 2)), nullptr, 16));
-
-        type = element_type::oid_element;
-        detail::serialise(m_data, out, oid);
-    } else if(name == "$ref" || name == "$id") {
-        if(doc.size() != 2)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "ref element"));
-        auto it = doc.find("$id");
-        if(it == doc.end() || it->type() != element_type::string_element)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "ref element"));
-        auto str = get<element_type::string_element>(*it);
-        if(str.size() != 24)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "oid element"));
-        std::array<char, 12> oid;
-        for(auto i = 0; i < 24; i += 2)
-            oid[i / 2] = static_cast<char>(std::stoi(boost::lexical_cast<std::string>(str.substr(i, 2)), nullptr, 16));
-
-        it = doc.find("$ref");
-        if(it == doc.end() || it->type() != element_type::string_element)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "ref element"));
-        auto coll = get<element_type::string_element>(*it);
-
-        type = element_type::db_pointer_element;
-        detail::serialise(m_data, out, std::make_tuple(coll, oid));
-    } else if(name == "$undefined") {
-        if(doc.size() != 1)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "undefined element"));
-        type = element_type::undefined_element;
-    } else if(name == "$minkey") {
-        if(doc.size() != 1)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "minkey element"));
-        type = element_type::min_key;
-    } else if(name == "$maxkey") {
-        if(doc.size() != 1)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, "maxkey element"));
-        type = element_type::max_key;
-    } else
-        return std::make_tuple(boost::none, (element_type)0);
-    return std::make_tuple(out, type);
-}
-
-template <typename ForwardIterator, typename OutputIterator>
-OutputIterator json_reader::parse_string(line_pos_iterator<ForwardIterator>& first,
-                                         const line_pos_iterator<ForwardIterator>& last, OutputIterator out) {
-    assert(last != first);
-
-    assert(out >= m_data.begin() && out <= m_data.end());
-    out = m_data.insert(out, 4, '\0');
-
-    const auto size = std::distance(m_data.begin(), std::next(out, 4));
-    out = parse_name(first, last, std::next(out, 4), true);
-    boost::range::copy(detail::native_to_little_endian<int32_t>(m_data.size() - size),
-                       std::next(m_data.begin(), size - 4));
-    return out;
+    return true;
 }
 
 template <typename CharT> constexpr bool iscntrl(CharT c) {
@@ -579,25 +1380,32 @@ template <typename CharT> constexpr bool isspace(CharT c) {
     return c == 0x20 || (std::make_unsigned_t<CharT>)(c - '\t') < 5;
 }
 
-template <typename ForwardIterator, typename OutputIterator>
-OutputIterator json_reader::parse_name(line_pos_iterator<ForwardIterator>& first,
-                                       const line_pos_iterator<ForwardIterator>& last, OutputIterator out,
-                                       bool allow_null) {
-    using char_type = typename std::iterator_traits<ForwardIterator>::value_type;
+
+template <json_parse_policy Policy>
+template <typename Iterator>
+bool basic_json_parser<Policy>::parse_string(Iterator& first, const Iterator& last, std::experimental::string_view& str,
+                                             bool allow_null) {
+    using char_type = typename std::iterator_traits<Iterator>::value_type;
     assert(last != first);
     if(first == last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
+        return fail(json_error_num::unexpected_end_of_range, first);
     if(*first != '"')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last, "\""));
+        return fail(json_error_num::unexpected_token, first, "\"");
     std::advance(first, 1);
 
+    m_buffer.clear();
+    if(take_plain_string(first, last, str))
+        return true;
+
     codecvt_t<char_type> cvt;
     auto state = create_state<char_type>();
     std::array<char_type, 2> buf;
 
     while(true) {
+        if(!append_plain_run(first, last))
+            return false;
         if(first == last)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
+            return fail(json_error_num::unexpected_end_of_range, first);
 
         buf[0] = *first;
 
@@ -606,6 +1414,8 @@ OutputIterator json_reader::parse_name(line_pos_iterator<ForwardIterator>& first
             break;
         }
         if(buf[0] == '\0' && !allow_null) {
+            // the index would still consider this part of a string
+            m_index.clear();
             std::advance(first, 1);
             break;
         }
@@ -617,15 +1427,20 @@ OutputIterator json_reader::parse_name(line_pos_iterator<ForwardIterator>& first
             buf[1] = 0;
 
         if(buf[0] == '\\') {
-            out = parse_escape(first, last, out);
+            if(!parse_escape(first, last))
+                return false;
             continue;
-        } else if(detail::iscntrl(buf[0]))
-            BOOST_THROW_EXCEPTION(
-                make_parse_exception(json_error_num::unexpected_token, first, last, "non-control char"));
-
-        if(std::is_same<char_type, container_type::value_type>::value) {
-            assert(out >= m_data.begin() && out <= m_data.end());
-            out = std::next(m_data.insert(out, buf[0]));
+        } else if(validate && detail::iscntrl(buf[0]))
+            return fail(json_error_num::unexpected_token, first, "non-control char");
+
+        if(std::is_same<char_type, char>::value) {
+            // trusted UTF-8 is copied a byte at a time
+            const auto len = validate ? utf8_sequence_length(first, last) : 1;
+            if(len == 0)
+                return fail(json_error_num::unexpected_token, first, "valid utf-8");
+            append(buf[0]);
+            for(size_t i = 1; i < len; i++)
+                append(*++first);
         } else {
             std::array<char, ((sizeof(buf) < 2 * sizeof(char16_t)) ? (2 * sizeof(char16_t)) : sizeof(buf)) + 1> to;
             to.fill(0);
@@ -633,51 +1448,176 @@ OutputIterator json_reader::parse_name(line_pos_iterator<ForwardIterator>& first
             char* to_next;
             auto res = cvt.out(state, buf.data(), buf.data() + (buf[1] ? 2 : 1), frm_next, to.data(),
                                to.data() + to.size(), to_next);
-            if(!state_test(&state) || res != std::codecvt_base::ok)
-                BOOST_THROW_EXCEPTION(
-                    make_parse_exception(json_error_num::unexpected_token, first, last, "valid unicode code point(s)"));
-            auto len = std::strlen(to.data());
-            out = m_data.insert(out, len, '\0');
-            out = std::copy(to.data(), to.data() + len, out);
+            if(validate && (!state_test(&state) || res != std::codecvt_base::ok))
+                return fail(json_error_num::unexpected_token, first, "valid unicode code point(s)");
+            append(to.data(), to.data() + std::strlen(to.data()));
         }
 
         std::advance(first, 1);
     }
-    assert(out >= m_data.begin() && out <= m_data.end());
-    return std::next(m_data.insert(out, '\0'));
+    str = {m_buffer.data(), m_buffer.size()};
+    return true;
+}
+
+// The key is first compared, with its closing quote, to the one at the same index in the last object at this depth.
+// Only keys passed on straight from the input are remembered, so one which matches needs no decoding or validating.
+template <json_parse_policy Policy>
+inline bool basic_json_parser<Policy>::parse_key(const char*& first, const char* const& last,
+                                                 std::experimental::string_view& key, size_t depth, size_t idx) {
+    if(depth < m_shapes.size() && idx < m_shapes[depth].ends.size() &&
+       static_cast<size_t>(last - first) > simd::equal_prefix_padding && *first == '"') {
+        const auto& shape = m_shapes[depth];
+        const size_t begin = idx == 0 ? 0 : shape.ends[idx - 1];
+        const size_t len = shape.ends[idx] - begin;
+        if(len <= simd::equal_prefix_padding && simd::equal_prefix(first + 1, shape.bytes.data() + begin, len)) {
+            key = {first + 1, len - 1};
+            first += len + 1;
+            return true;
+        }
+    }
+    return parse_unpredicted_key(first, last, key, depth, idx);
+}
+
+// Long keys, and those near the end of input, are compared byte by byte. Any other mismatch replaces the prediction,
+// along with the rest of the last object's keys.
+template <json_parse_policy Policy>
+bool basic_json_parser<Policy>::parse_unpredicted_key(const char*& first, const char* const& last,
+                                                      std::experimental::string_view& key, size_t depth, size_t idx) {
+    if(depth >= m_shapes.size())
+        m_shapes.resize(depth + 1);
+    auto& shape = m_shapes[depth];
+    if(idx < shape.ends.size()) {
+        const size_t begin = idx == 0 ? 0 : shape.ends[idx - 1];
+        const size_t len = shape.ends[idx] - begin;
+        if(first != last && *first == '"' && static_cast<size_t>(last - first) > len &&
+           std::memcmp(first + 1, shape.bytes.data() + begin, len) == 0) {
+            key = {first + 1, len - 1};
+            first += len + 1;
+            return true;
+        }
+        shape.ends.resize(idx);
+        shape.bytes.resize(begin + simd::equal_prefix_padding);
+    }
+
+    const auto start = first;
+    if(!parse_string(first, last, key, false))
+        return false;
+    if(idx == shape.ends.size() && key.data() == start + 1 && shape.bytes.size() + key.size() < max_shape_size) {
+        shape.bytes.resize(shape.ends.empty() ? 0 : shape.ends.back());
+        shape.bytes.insert(shape.bytes.end(), key.data(), key.data() + key.size() + 1);
+        shape.ends.push_back(static_cast<uint32_t>(shape.bytes.size()));
+        shape.bytes.resize(shape.bytes.size() + simd::equal_prefix_padding);
+    }
+    return true;
 }
 
-template <typename ForwardIterator, typename OutputIterator>
-OutputIterator json_reader::parse_escape(line_pos_iterator<ForwardIterator>& first,
-                                         const line_pos_iterator<ForwardIterator>& last, OutputIterator out) {
+// Passes on a string without copying it when there's nothing to decode, otherwise starts decoding it.
+template <json_parse_policy Policy>
+bool basic_json_parser<Policy>::take_plain_string(const char*& first, const char* const& last,
+                                                  std::experimental::string_view& str) {
+    bool ascii = true;
+    auto end = simd::find_string_special(first, last, ascii);
+    if(validate && !ascii && !m_index.valid_utf8())
+        end = simd::validate_utf8(first, end);
+    if(end != last && *end == '"') {
+        str = {first, static_cast<size_t>(end - first)};
+        first = end + 1;
+        return true;
+    }
+    append(first, end);
+    first = end;
+    return false;
+}
+
+// Appends the plain characters at first in one go, up to the next quote, escape, control character or malformed
+// UTF-8, which are left to parse_string.
+template <json_parse_policy Policy>
+bool basic_json_parser<Policy>::append_plain_run(const char*& first, const char* const& last) {
+    bool ascii = true;
+    auto end = simd::find_string_special(first, last, ascii);
+    if(validate && !ascii && !m_index.valid_utf8())
+        end = simd::validate_utf8(first, end);
+    append(first, end);
+    first = end;
+    return true;
+}
+
+// Transcodes plain string content from UTF-16 or UTF-32 a block at a time, narrowing runs of ASCII a vector at a time.
+template <json_parse_policy Policy>
+template <typename CharT> bool basic_json_parser<Policy>::append_utf_run(const CharT*& first, const CharT* last) {
+    std::array<char, 256> buf;
+    const auto buf_end = buf.data() + buf.size();
+    auto out = buf.data();
+    while(first != last) {
+        // leave room for a whole code point
+        if(buf_end - out < 4) {
+            append(buf.data(), out);
+            out = buf.data();
+        }
+        const auto end = simd::narrow_plain_ascii(first, first + std::min(last - first, buf_end - out), out);
+        out += end - first;
+        first = end;
+        if(first == last)
+            break;
+
+        auto cp = static_cast<uint32_t>(*first);
+        if(cp < 0x80) {
+            if(!simd::is_plain_ascii(*first))
+                break;
+            continue;
+        }
+        if(buf_end - out < 4) {
+            append(buf.data(), out);
+            out = buf.data();
+        }
+        if(std::is_same<CharT, char16_t>::value && cp >= 0xd800 && cp <= 0xdfff) {
+            const auto low = first + 1 != last ? static_cast<uint32_t>(first[1]) : 0;
+            if(validate && (cp > 0xdbff || low < 0xdc00 || low > 0xdfff))
+                return fail(json_error_num::unexpected_token, first, "valid unicode code point(s)");
+            if(first + 1 == last)
+                return fail(json_error_num::unexpected_end_of_range, last);
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            ++first;
+        } else if(validate && cp > 0x10ffff)
+            return fail(json_error_num::unexpected_token, first, "valid unicode code point(s)");
+        ++first;
+        out = encode_utf8(cp, out);
+    }
+    append(buf.data(), out);
+    return true;
+}
+
+template <json_parse_policy Policy>
+template <typename Iterator> bool basic_json_parser<Policy>::parse_escape(Iterator& first, const Iterator& last) {
     assert(last != first);
     assert(*first == '\\');
     std::advance(first, 1);
 
     if(first == last || *first == '\0')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_end_of_range, first, last));
+        return fail(json_error_num::unexpected_end_of_range, first);
     auto c = *first++;
     if(c == '"')
-        out = std::next(m_data.insert(out, '"'));
+        append('"');
     else if(c == '/')
-        out = std::next(m_data.insert(out, '/'));
+        append('/');
     else if(c == '\\')
-        out = std::next(m_data.insert(out, '\\'));
+        append('\\');
     else if(c == 'b')
-        out = std::next(m_data.insert(out, '\b'));
+        append('\b');
     else if(c == 'f')
-        out = std::next(m_data.insert(out, '\f'));
+        append('\f');
     else if(c == 'n')
-        out = std::next(m_data.insert(out, '\n'));
+        append('\n');
     else if(c == 'r')
-        out = std::next(m_data.insert(out, '\r'));
+        append('\r');
     else if(c == 't')
-        out = std::next(m_data.insert(out, '\t'));
+        append('\t');
     else if(c == 'u') {
-        if(std::next(first, 4) !=
-           std::find_if_not(first, std::next(first, 4), [](auto&& c) { return detail::isxdigit(c); }))
-            BOOST_THROW_EXCEPTION(
-                make_parse_exception(json_error_num::unexpected_token, first, last, "4x hex (0-9;a-f/A-F)"));
+        if(!detail::has_length(first, last, 4))
+            return fail(json_error_num::unexpected_end_of_range, last);
+        if(validate && std::next(first, 4) != std::find_if_not(first, std::next(first, 4),
+                                                               [](auto&& c) { return detail::isxdigit(c); }))
+            return fail(json_error_num::unexpected_token, first, "4x hex (0-9;a-f/A-F)");
 
         std::array<char, 5> buf;
         buf.back() = 0;
@@ -688,38 +1628,37 @@ OutputIterator json_reader::parse_escape(line_pos_iterator<ForwardIterator>& fir
         std::array<char16_t, 2> codepoints;
         codepoints[0] = std::strtol(buf.data(), &pos, 16);
         codepoints[1] = 0;
-        if(pos != buf.data() + 4)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token,
-                                                       std::next(first, pos - buf.data()), last,
-                                                       "valid hex characters (0-9;a-f/A-F)"));
+        if(validate && pos != buf.data() + 4)
+            return fail(json_error_num::unexpected_token, std::next(first, pos - buf.data()),
+                        "valid hex characters (0-9;a-f/A-F)");
 
         if(codepoints[0] == 0x0000) {
             auto null_str = R"(\u0000)";
             std::advance(first, 4);
-            out = m_data.insert(out, 6, '\0');
-            out = std::copy(null_str, null_str + 6, out);
-            return out;
+            append(null_str, null_str + 6);
+            return true;
         }
 
         if(codepoints[0] >= 0xD800 && codepoints[0] <= 0xDBFF) {
             // Handle UTF-16 surrogate pair
             std::advance(first, 4);
-            if(*first++ != '\\' || *first++ != 'u')
-                BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last,
-                                                           "trail surrogate after lead surrogate (utf-16)"));
-            if(std::next(first, 4) !=
-               std::find_if_not(first, std::next(first, 4), [](auto&& c) { return detail::isxdigit(c); }))
-                BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first, last,
-                                                           "4x valid hex characters (0-9;a-f/A-F)"));
+            if(!detail::has_length(first, last, 6))
+                return fail(json_error_num::unexpected_end_of_range, last);
+            if(!validate)
+                std::advance(first, 2);
+            else if(*first++ != '\\' || *first++ != 'u')
+                return fail(json_error_num::unexpected_token, first, "trail surrogate after lead surrogate (utf-16)");
+            else if(std::next(first, 4) !=
+                    std::find_if_not(first, std::next(first, 4), [](auto&& c) { return detail::isxdigit(c); }))
+                return fail(json_error_num::unexpected_token, first, "4x valid hex characters (0-9;a-f/A-F)");
 
             std::copy(first, std::next(first, 4), buf.begin());
             assert(buf.back() == 0);
 
             codepoints[1] = std::strtol(buf.data(), &pos, 16);
-            if(pos != buf.data() + 4)
-                BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token,
-                                                           std::next(first, pos - buf.data()), last,
-                                                           "valid hex characters (0-9;a-f/A-F)"));
+            if(validate && pos != buf.data() + 4)
+                return fail(json_error_num::unexpected_token, std::next(first, pos - buf.data()),
+                            "valid hex characters (0-9;a-f/A-F)");
         }
 
         codecvt<char16_t> cvt16;
@@ -729,148 +1668,939 @@ OutputIterator json_reader::parse_escape(line_pos_iterator<ForwardIterator>& fir
         char* to_next;
         auto res = cvt16.out(state, codepoints.data(), codepoints.data() + codepoints.size(), frm_next, buf.data(),
                              buf.data() + buf.size(), to_next);
-        if(!state_test(&state) || res != std::codecvt_base::ok)
-            BOOST_THROW_EXCEPTION(
-                make_parse_exception(json_error_num::unexpected_token, first, last, "valid unicode code point(s)"));
+        if(validate && (!state_test(&state) || res != std::codecvt_base::ok))
+            return fail(json_error_num::unexpected_token, first, "valid unicode code point(s)");
         std::advance(first, 4);
-        const auto len = std::strlen(buf.data());
-        out = m_data.insert(out, len, '\0');
-        out = std::copy(buf.data(), buf.data() + len, out);
+        append(buf.data(), buf.data() + std::strlen(buf.data()));
     } else
-        BOOST_THROW_EXCEPTION(
-            make_parse_exception(json_error_num::unexpected_token, first, last, "valid control char"));
-    return out;
+        return fail(json_error_num::unexpected_token, first, "valid control char");
+    return true;
 }
 
-template <typename Num> struct real_parse_policy : boost::spirit::qi::real_policies<Num> {
-    static bool const allow_leading_dot = false;
-    static bool const allow_trailing_dot = false;
-    template <typename... Args> static bool parse_nan(Args&&...) {
-        return false;
+template <json_parse_policy Policy>
+template <typename Handler, typename Iterator>
+bool basic_json_parser<Policy>::parse_number(Handler& handler, Iterator& first, const Iterator& last) {
+    assert(last != first);
+
+    const auto begin = base_iterator(first);
+    const auto num = parse_json_number<validate>(begin, base_iterator(last));
+    if(!num.ok)
+        return fail(json_error_num::unexpected_token, std::next(first, std::distance(begin, num.ptr)), "number");
+    std::advance(first, std::distance(begin, num.ptr));
+
+    if(num.is_float)
+        handler.double_value(num.real);
+    else if(num.integer > std::numeric_limits<int32_t>::min() && num.integer < std::numeric_limits<int32_t>::max())
+        handler.int32_value(static_cast<int32_t>(num.integer));
+    else
+        handler.int64_value(num.integer);
+    return true;
+}
+
+// Skips a value without decoding it. Containers are only checked for balanced brackets outside of strings.
+template <json_parse_policy Policy>
+template <typename Iterator>
+bool basic_json_parser<Policy>::skip_value(Iterator& first, const Iterator& last) {
+    if(*first == '"')
+        return skip_string(first, last);
+    if(*first != '{' && *first != '[') {
+        const auto start = first;
+        first = std::find_if(first, last, [](auto&& c) { return isspace(c) || c == ',' || c == '}' || c == ']'; });
+        return first != start || fail(json_error_num::unexpected_token, first, "value");
     }
-    template <typename... Args> static bool parse_inf(Args&&...) {
-        return false;
+    size_t depth = 0;
+    while(first != last) {
+        const auto c = *first;
+        if(c == '"') {
+            if(!skip_string(first, last))
+                return false;
+            continue;
+        }
+        ++first;
+        if(c == '{' || c == '[')
+            ++depth;
+        else if((c == '}' || c == ']') && --depth == 0)
+            return true;
     }
-};
+    return fail(json_error_num::unexpected_end_of_range, first);
+}
 
-template <typename ForwardIterator, typename OutputIterator>
-std::tuple<OutputIterator, element_type> json_reader::parse_number(line_pos_iterator<ForwardIterator>& first_,
-                                                                   const line_pos_iterator<ForwardIterator>& last_,
-                                                                   OutputIterator out) {
-    assert(last_ != first_);
-
-    if(!isdigit(*first_) && *first_ != '-')
-        BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token, first_, last_, "number"));
-
-    bool is_float = false;
-    ForwardIterator first = first_.base();
-    ForwardIterator last;
-    // find end of number and presence of decimal point or exponent
-    std::tie(is_float, last) = [this](auto first_, auto last_) {
-        auto first = first_.base(), last = last_.base();
-        bool dec = false, e = false;
-        for(; first != last; first++) {
-            if(isdigit(*first))
-                continue;
-            switch(*first) {
-                case '+':
-                case '-':
-                    break;
-                case '.':
-                    if(!dec)
-                        dec = true;
-                    else
-                        BOOST_THROW_EXCEPTION(make_parse_exception(
-                            json_error_num::unexpected_token, std::next(first_, std::distance(first_.base(), first)),
-                            last_, "number"));
-                    break;
-                case 'e':
-                case 'E':
-                    if(!e)
-                        e = true;
-                    else
-                        BOOST_THROW_EXCEPTION(make_parse_exception(
-                            json_error_num::unexpected_token, std::next(first_, std::distance(first_.base(), first)),
-                            last_, "number"));
-                    break;
-                default:
-                    return std::make_tuple(dec || e, first);
+// The structural index has every bracket outside of strings, so containers are skipped by counting only those.
+template <json_parse_policy Policy>
+bool basic_json_parser<Policy>::skip_value(const char*& first, const char* const& last) {
+    if(!m_index || (*first != '{' && *first != '['))
+        return skip_value<const char*>(first, last);
+    size_t depth = 0;
+    for(auto p = m_index.next(first); p != last; p = m_index.next(p + 1)) {
+        if(*p == '{' || *p == '[')
+            ++depth;
+        else if((*p == '}' || *p == ']') && --depth == 0) {
+            first = p + 1;
+            return true;
+        }
+    }
+    first = last;
+    return fail(json_error_num::unexpected_end_of_range, first);
+}
+
+template <json_parse_policy Policy>
+template <typename Iterator>
+bool basic_json_parser<Policy>::skip_string(Iterator& first, const Iterator& last) {
+    ++first;
+    while(first != last) {
+        const auto c = *first;
+        ++first;
+        if(c == '"')
+            return true;
+        if(c == '\\' && first != last)
+            ++first;
+    }
+    return fail(json_error_num::unexpected_end_of_range, first);
+}
+
+template <json_parse_policy Policy>
+bool basic_json_parser<Policy>::skip_string(const char*& first, const char* const& last) {
+    ++first;
+    while(true) {
+        bool ascii = true;
+        first = simd::find_string_special(first, last, ascii);
+        if(first == last)
+            return fail(json_error_num::unexpected_end_of_range, first);
+        if(*first++ == '"')
+            return true;
+        if(first[-1] == '\\' && first != last)
+            ++first;
+    }
+}
+
+template <json_parse_policy Policy>
+template <typename Iterator> void basic_json_parser<Policy>::skip_space(Iterator& first, const Iterator& last) {
+    first = std::find_if_not(first, last, [](auto&& c) { return isspace(c); });
+}
+
+template <json_parse_policy Policy>
+void basic_json_parser<Policy>::skip_space(const char*& first, const char* const& last) {
+    if(first == last || !isspace(*first))
+        return;
+    if(m_index)
+        first = m_index.next(first);
+    else
+        first = simd::skip_space(first, last);
+}
+
+// Between chunks a stream is what's expected next, the containers left open on m_stack, and any token split between
+// chunks. Errors are located in the stream as a whole, whose lines are counted as each chunk is parsed.
+template <json_parse_policy Policy>
+template <typename Handler>
+const char* basic_json_parser<Policy>::feed(Handler& handler, const char* first, const char* last, bool& closed) {
+    const auto start = first;
+    m_start = &start;
+    m_error = json_error{};
+    m_stream.token_failed = false;
+    closed = false;
+    bool ok;
+    try {
+        ok = feed_tokens(handler, first, last, closed);
+    } catch(json_parse_error& e) {
+        m_start = nullptr;
+        // errors from the handler can't know where they occurred
+        if(!boost::get_error_info<line_number>(e))
+            add_stream_position(e, m_stream.offset + (first - start), start, last);
+        throw;
+    } catch(...) {
+        m_start = nullptr;
+        throw;
+    }
+    m_start = nullptr;
+    if(!ok) {
+        auto e = make_parse_exception(m_error.num, m_error.expected);
+        add_stream_position(e, m_error.offset + (m_stream.token_failed ? m_stream.token_offset : m_stream.offset),
+                            start, last);
+        BOOST_THROW_EXCEPTION(e);
+    }
+    count_lines(start, first);
+    return first;
+}
+
+template <json_parse_policy Policy> void basic_json_parser<Policy>::finish() {
+    if(m_stream.expect != stream_expect::root) {
+        auto e = make_parse_exception(json_error_num::unexpected_end_of_range);
+        add_stream_position(e, m_stream.offset, nullptr, nullptr);
+        BOOST_THROW_EXCEPTION(e);
+    }
+    reset_stream();
+}
+
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::feed_tokens(Handler& handler, const char*& first, const char* last, bool& closed) {
+    auto& s = m_stream;
+    if(s.pending != stream_token::none && !resume_token(handler, first, last))
+        return false;
+    while(true) {
+        first = simd::skip_space(first, last);
+        if(first == last)
+            return true;
+        const auto c = *first;
+        const auto object = !m_stack.empty() && m_stack.back().object;
+        if((s.expect == stream_expect::key_or_close && c == '}') ||
+           (s.expect == stream_expect::value_or_close && c == ']') ||
+           (s.expect == stream_expect::comma_or_close && c == (object ? '}' : ']'))) {
+            if(!close_streamed(handler, first))
+                return false;
+            if(m_stack.empty()) {
+                closed = true;
+                return true;
             }
+            continue;
         }
-        return std::make_tuple(dec || e, first);
-    }(first_, last_);
+        switch(s.expect) {
+            case stream_expect::root:
+                if(c != '{' && c != '[')
+                    return fail(json_error_num::invalid_root_element, first);
+                if(!open_streamed(handler, first))
+                    return false;
+                break;
+            case stream_expect::key_or_close:
+            case stream_expect::key:
+                if(c != '"')
+                    return fail(json_error_num::unexpected_token, first, "\"");
+                if(!start_token(handler, first, last, stream_token::key))
+                    return false;
+                break;
+            case stream_expect::colon:
+                if(c != ':')
+                    return fail(json_error_num::unexpected_token, first, ":");
+                ++first;
+                s.expect = stream_expect::value;
+                break;
+            case stream_expect::comma_or_close:
+                if(c != ',')
+                    return fail(json_error_num::unexpected_token, first, object ? "}" : ", or ]");
+                ++first;
+                s.expect = object ? stream_expect::key : stream_expect::value;
+                break;
+            case stream_expect::value_or_close:
+            case stream_expect::value:
+                if(c == '{' || c == '[') {
+                    if(!open_streamed(handler, first))
+                        return false;
+                } else if(!start_token(handler, first, last,
+                                       c == '"' ? stream_token::string : c == 't' || c == 'f' || c == 'n'
+                                                                             ? stream_token::literal
+                                                                             : stream_token::number))
+                    return false;
+                break;
+        }
+    }
+}
 
-    assert(is_float == std::any_of(first, last, [](auto&& c) { return c == '.' || c == 'e' || c == 'E'; }));
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::open_streamed(Handler& handler, const char*& first) {
+    if(m_stack.size() >= m_max_depth)
+        return fail(json_error_num::nesting_too_deep, first);
+    const auto object = *first == '{';
+    m_stack.push_back({object, 0});
+    if(object)
+        handler.start_object();
+    else
+        handler.start_array();
+    if(rejected(handler, first))
+        return false;
+    ++first;
+    m_stream.expect = object ? stream_expect::key_or_close : stream_expect::value_or_close;
+    return true;
+}
 
-    const auto num_len = std::distance(first, last);
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::close_streamed(Handler& handler, const char*& first) {
+    if(m_stack.back().object)
+        handler.end_object();
+    else
+        handler.end_array();
+    m_stack.pop_back();
+    if(rejected(handler, first))
+        return false;
+    ++first;
+    end_streamed_value();
+    return true;
+}
 
-    if(*first_ == '0' && num_len > 1 && *std::next(first) != '.')
-        BOOST_THROW_EXCEPTION(make_parse_exception(
-            json_error_num::unexpected_token, std::next(first_, std::distance(first_.base(), first)), last_, "number"));
-    auto type = element_type::null_element;
+template <json_parse_policy Policy> void basic_json_parser<Policy>::end_streamed_value() noexcept {
+    m_stream.expect = m_stack.empty() ? stream_expect::root : stream_expect::comma_or_close;
+}
 
-    if(is_float) {
-        double val;
-        static const boost::spirit::qi::any_real_parser<double, detail::real_parse_policy<double>> dbl_parser{};
-        auto ok = dbl_parser.parse(first, last, boost::spirit::unused, boost::spirit::unused, val);
-        if(!ok)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token,
-                                                       std::next(first_, std::distance(first_.base(), first)), last_,
-                                                       "number"));
-
-        assert(out >= m_data.begin() && out <= m_data.end());
-        serialise(m_data, out, val);
-        type = element_type::double_element;
-    } else {
-        int64_t val = 0;
-        auto ok = boost::spirit::qi::extract_int<int64_t, 10, 1, -1>::call(first, last, val);
-        if(!ok)
-            BOOST_THROW_EXCEPTION(make_parse_exception(json_error_num::unexpected_token,
-                                                       std::next(first_, std::distance(first_.base(), first)), last_,
-                                                       "number"));
-
-        if(val > std::numeric_limits<int32_t>::min() && val < std::numeric_limits<int32_t>::max()) {
-            assert(out >= m_data.begin() && out <= m_data.end());
-            serialise(m_data, out, static_cast<int32_t>(val));
-            type = element_type::int32_element;
-        } else {
-            assert(out >= m_data.begin() && out <= m_data.end());
-            serialise(m_data, out, val);
-            type = element_type::int64_element;
+// A token wholly within the chunk is parsed where it is; otherwise it's buffered until the rest is fed.
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::start_token(Handler& handler, const char*& first, const char* last,
+                                            stream_token kind) {
+    auto end = kind == stream_token::string || kind == stream_token::key ? first + 1 : first;
+    auto complete = false;
+    m_stream.escaped = false;
+    if(!scan_token(end, last, kind, complete))
+        return false;
+    if(complete && (kind == stream_token::number || kind == stream_token::literal ||
+                    static_cast<size_t>(last - end) >= stream_padding))
+        return parse_token(handler, first, end, kind);
+    m_stream.token.assign(first, end);
+    m_stream.token_offset = m_stream.offset + (first - *static_cast<const char* const*>(m_start));
+    first = end;
+    if(complete)
+        return parse_buffered_token(handler, kind);
+    m_stream.pending = kind;
+    return true;
+}
+
+// Continues a token from the start of a chunk, parsing it once complete.
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::resume_token(Handler& handler, const char*& first, const char* last) {
+    auto& s = m_stream;
+    auto end = first;
+    auto complete = false;
+    if(!scan_token(end, last, s.pending, complete))
+        return false;
+    s.token.insert(s.token.end(), first, end);
+    first = end;
+    if(!complete)
+        return true;
+    const auto kind = s.pending;
+    s.pending = stream_token::none;
+    return parse_buffered_token(handler, kind);
+}
+
+// Parses the whole token in m_stream.token, padded so malformed escapes can't be read past its end.
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::parse_buffered_token(Handler& handler, stream_token kind) {
+    auto& s = m_stream;
+    const auto size = s.token.size();
+    s.token.resize(size + stream_padding, '\0');
+    // errors are located relative to the start of the token
+    const auto chunk_start = m_start;
+    const char* token_start = s.token.data();
+    auto first = token_start;
+    m_start = &token_start;
+    const auto ok = parse_token(handler, first, token_start + size, kind);
+    m_start = chunk_start;
+    s.token.resize(size);
+    s.token_failed = !ok;
+    if(ok)
+        s.token.clear();
+    return ok;
+}
+
+// Finds the end of a token, from p, which is set past it when complete. Strings may continue from a previous chunk,
+// escaped as it ended.
+template <json_parse_policy Policy>
+bool basic_json_parser<Policy>::scan_token(const char*& p, const char* last, stream_token kind, bool& complete) {
+    if(kind == stream_token::number) {
+        p = std::find_if_not(p, last, [](char c) { return number::is_number_char(c); });
+        complete = p != last;
+        return true;
+    }
+    if(kind == stream_token::literal) {
+        p = std::find_if_not(p, last, [](char c) { return c >= 'a' && c <= 'z'; });
+        complete = p != last;
+        return true;
+    }
+    auto escaped = m_stream.escaped;
+    while(p != last) {
+        if(escaped) {
+            escaped = false;
+            ++p;
+            continue;
         }
+        bool ascii = true;
+        p = simd::find_string_special(p, last, ascii);
+        if(p == last)
+            break;
+        const auto c = *p++;
+        if(c == '"') {
+            complete = true;
+            return true;
+        }
+        if(c == '\\')
+            escaped = true;
+        else if(validate)
+            // found here rather than by parse_string, so a buffered token never spans lines
+            return fail(json_error_num::unexpected_token, p - 1, "non-control char");
     }
+    m_stream.escaped = escaped;
+    complete = false;
+    return true;
+}
 
+// Parses a whole token, which is all of [first, last).
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::parse_token(Handler& handler, const char*& first, const char* last,
+                                            stream_token kind) {
+    switch(kind) {
+        case stream_token::key: {
+            std::experimental::string_view key;
+            if(!parse_string(first, last, key, false))
+                return false;
+            if(first != last)
+                return fail(json_error_num::unexpected_token, first, ":");
+            handler.key(key);
+            if(rejected(handler, first))
+                return false;
+            m_stream.expect = stream_expect::colon;
+            return true;
+        }
+        case stream_token::string: {
+            std::experimental::string_view str;
+            if(!parse_string(first, last, str))
+                return false;
+            handler.string_value(str);
+        } break;
+        case stream_token::literal:
+            if(!parse_literal(handler, first, last))
+                return false;
+            break;
+        default:
+            if(first == last)
+                return fail(json_error_num::unexpected_token, first, "number");
+            if(!parse_number(handler, first, last))
+                return false;
+            break;
+    }
     if(first != last)
-        BOOST_THROW_EXCEPTION(make_parse_exception(
-            json_error_num::unexpected_token, std::next(first_, std::distance(first_.base(), first)), last_, "number"));
+        return fail(json_error_num::unexpected_token, first, m_stack.back().object ? "}" : ", or ]");
+    if(rejected(handler, first))
+        return false;
+    end_streamed_value();
+    return true;
+}
+
+template <json_parse_policy Policy>
+template <typename Handler>
+bool basic_json_parser<Policy>::parse_literal(Handler& handler, const char*& first, const char* last) {
+    const auto c = *first;
+    const std::experimental::string_view literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+    if(validate && std::experimental::string_view(first, static_cast<size_t>(last - first)) != literal)
+        return fail(json_error_num::unexpected_token, first, literal.data());
+    first = last;
+    if(c == 'n')
+        handler.null_value();
+    else
+        handler.bool_value(c == 't');
+    return true;
+}
+
+// Moves the stream past [first, last), counting its lines.
+template <json_parse_policy Policy>
+void basic_json_parser<Policy>::count_lines(const char* first, const char* last) noexcept {
+    const auto lines = static_cast<size_t>(std::count(first, last, '\n'));
+    if(lines != 0) {
+        m_stream.line += lines;
+        const auto line = std::find(std::make_reverse_iterator(last), std::make_reverse_iterator(first), '\n').base();
+        m_stream.line_start = m_stream.offset + (line - first);
+    }
+    m_stream.offset += last - first;
+}
 
-    std::advance(first_, num_len);
+// Locates offset in the stream, where [first, last) is the chunk being fed. Only what's in that chunk of the line
+// around it is known, or the token it's in when that was split between chunks.
+template <json_parse_policy Policy>
+void basic_json_parser<Policy>::add_stream_position(json_parse_error& e, size_t offset, const char* first,
+                                                    const char* last) const {
+    auto line = m_stream.line;
+    auto line_start = m_stream.line_start;
+    auto begin = m_stream.token.data(), end = m_stream.token.data() + m_stream.token.size();
+    if(offset >= m_stream.offset) {
+        const auto current = first + std::min(offset - m_stream.offset, static_cast<size_t>(last - first));
+        line += std::count(first, current, '\n');
+        begin = std::find(std::make_reverse_iterator(current), std::make_reverse_iterator(first), '\n').base();
+        if(line != m_stream.line)
+            line_start = m_stream.offset + (begin - first);
+        end = std::find_if(current, last, [](char c) { return c == '\n' || c == '\r'; });
+    }
+    e << current_line_string(std::string(begin, end));
+    e << line_number(line);
+    e << line_position(offset - line_start + 1);
+}
 
-    return std::make_tuple(out, type);
+template <typename Container, json_parse_policy Policy>
+template <typename ForwardIterator>
+bool basic_json_reader<Container, Policy>::append_parse(ForwardIterator first, ForwardIterator last,
+                                                        json_error* error) {
+    m_frames.clear();
+    m_members.clear();
+    m_rejected = nullptr;
+    if(m_reserve_ratio > 0)
+        reserve(std::distance(base_iterator(first), base_iterator(last)));
+    if(error)
+        return m_parser.parse(*this, first, last, *error);
+    m_parser.parse(*this, first, last);
+    return true;
 }
 
+template <typename Container, json_parse_policy Policy>
 template <typename ForwardIterator>
-void json_reader::skip_space(line_pos_iterator<ForwardIterator>& first,
-                             const line_pos_iterator<ForwardIterator>& last) {
-    first = std::find_if_not(first, last, [](auto&& c) { return isspace(c); });
+void basic_json_reader<Container, Policy>::parse_into(container_type& out, ForwardIterator first,
+                                                      ForwardIterator last) {
+    JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
+    using std::swap;
+    const auto size = out.size();
+    swap(m_data, out);
+    try {
+        append_parse(first, last);
+    } catch(...) {
+        m_data.resize(size);
+        swap(m_data, out);
+        throw;
+    }
+    swap(m_data, out);
+}
+
+// The root is output as usual, except that each of its elements is moved into the set once complete.
+template <typename Container, json_parse_policy Policy>
+template <typename C, typename ForwardIterator>
+void basic_json_reader<Container, Policy>::parse_into(basic_document_set<C>& out, ForwardIterator first,
+                                                      ForwardIterator last) {
+    JBSON_CONCEPT_ASSERT((boost::ForwardIteratorConcept<ForwardIterator>));
+    reset();
+    m_set = &out;
+    m_insert = &insert_element<C>;
+    try {
+        append_parse(first, last);
+    } catch(...) {
+        m_set = nullptr;
+        reset();
+        throw;
+    }
+    m_set = nullptr;
+    reset();
+}
+
+// Output may follow earlier output, so grows geometrically rather than to fit each input exactly.
+template <typename Container, json_parse_policy Policy>
+void basic_json_reader<Container, Policy>::reserve(size_t input_size) {
+    const auto size = m_data.size() + static_cast<size_t>(input_size * m_reserve_ratio);
+    if(size > m_data.capacity())
+        m_data.reserve(std::max(size, m_data.capacity() * 2));
+}
+
+template <typename Container, json_parse_policy Policy>
+bool basic_json_reader<Container, Policy>::parse_array_elements(const char* first, const char* last,
+                                                                std::vector<size_t>& offsets) {
+    reset();
+    m_offsets = &offsets;
+    try {
+        const auto closed = m_parser.parse_array_elements(*this, first, last);
+        m_offsets = nullptr;
+        return closed;
+    } catch(...) {
+        m_offsets = nullptr;
+        throw;
+    }
+}
+
+// Each value is preceded by its type, which is written either before its name or over a placeholder left by key().
+template <typename Container, json_parse_policy Policy>
+void basic_json_reader<Container, Policy>::begin_value(element_type type) {
+    if(m_frames.empty()) {
+        // the root has no type, unless it's one of a run of array elements
+        m_type_idx = m_offsets ? m_data.size() : no_type;
+        if(m_offsets) {
+            m_offsets->push_back(m_type_idx);
+            append(static_cast<char>(type));
+        }
+        return;
+    }
+    auto& f = m_frames.back();
+    if(f.array) {
+        if(m_set && m_frames.size() == 1)
+            insert_element(f.start);
+        m_type_idx = m_data.size();
+        append(static_cast<char>(type));
+        index_key_buffer buf;
+        const auto name = index_key(f.count++, buf);
+        append(name.begin(), name.end() + 1);
+    } else if(f.extended) {
+        m_members.push_back({m_key, type, m_data.size()});
+        m_type_idx = no_type;
+    } else
+        m_data[m_type_idx] = static_cast<char>(type);
 }
 
+template <typename Container, json_parse_policy Policy>
+void basic_json_reader<Container, Policy>::start_container(element_type type, bool array) {
+    begin_value(type);
+    const auto nested = !m_frames.empty() || m_offsets != nullptr;
+    // elements of arrays are projected like the arrays themselves
+    const auto path =
+        m_frames.empty() ? m_projection.root() : m_frames.back().array ? m_frames.back().path : m_path;
+    m_frames.push_back({append_size_slot(), m_type_idx, m_members.size(), 0, array, nested, false, path});
+}
+
+// Removes the member just named, as it leads to selected members but isn't an object, so can't contain any.
+template <typename Container, json_parse_policy Policy> bool basic_json_reader<Container, Policy>::drop_member() {
+    m_data.resize(m_type_idx);
+    --m_frames.back().count;
+    return true;
+}
+
+template <typename Container, json_parse_policy Policy>
+void basic_json_reader<Container, Policy>::key(std::experimental::string_view name) {
+    auto& f = m_frames.back();
+    if(m_set && m_frames.size() == 1)
+        insert_element(f.start);
+    m_path = json_projection::all;
+    if(f.path != json_projection::all) {
+        // members of projected objects are output only when selected, and never as extended json values
+        m_path = m_projection.child(f.path, name);
+        if(m_path == json_projection::none) {
+            m_skip = true;
+            return;
+        }
+    } else if(f.nested && (f.count == 0 || f.extended)) {
+        // objects whose first member is named like an extended json value are output as such
+        const auto key = match_extended_key(name);
+        if(f.extended && (key == extended_key::none || f.count == 2)) {
+            m_rejected = "extended json value";
+            return;
+        }
+        if(key != extended_key::none) {
+            f.extended = true;
+            m_key = key;
+            ++f.count;
+            return;
+        }
+    }
+    ++f.count;
+    m_type_idx = m_data.size();
+    append(static_cast<char>(element_type::null_element));
+    append(name.begin(), name.end());
+    append('\0');
+}
+
+template <typename Container, json_parse_policy Policy> void basic_json_reader<Container, Policy>::end_object() {
+    const auto f = m_frames.back();
+    m_frames.pop_back();
+    if(m_set && m_frames.empty())
+        insert_element(f.start);
+    if(!f.extended) {
+        close_document(f.start);
+        return;
+    }
+    const auto type = close_extended(f);
+    if(m_rejected)
+        return;
+    m_members.resize(f.members);
+    if(f.type_idx != no_type)
+        m_data[f.type_idx] = static_cast<char>(type);
+    else {
+        assert(!m_frames.empty() && m_frames.back().extended);
+        m_members.back().type = type;
+    }
+}
+
+template <typename Container, json_parse_policy Policy>
+void basic_json_reader<Container, Policy>::close_document(size_t start_idx) {
+    append('\0');
+
+    const int32_t size = m_data.size() - start_idx;
+    if(size < 5)
+        BOOST_THROW_EXCEPTION(invalid_document_size{} << detail::expected_size(5) << detail::actual_size(size));
+    patch_size_slot(start_idx, size);
+}
+
+// Moves the root's last element, if any, from the output into the set being parsed into.
+template <typename Container, json_parse_policy Policy>
+void basic_json_reader<Container, Policy>::insert_element(size_t root_idx) {
+    const auto idx = root_idx + sizeof(int32_t);
+    if(m_data.size() == idx)
+        return;
+    m_insert(m_set, m_data.data() + idx, m_data.data() + m_data.size());
+    m_data.resize(idx);
+}
+
+template <typename Container, json_parse_policy Policy>
+template <typename C>
+void basic_json_reader<Container, Policy>::insert_element(void* set, const char* first, const char* last) {
+    const auto name = first + 1;
+    const auto value = name + std::strlen(name) + 1;
+    static_cast<basic_document_set<C>*>(set)->emplace(std::string(name, value - 1), static_cast<element_type>(*first),
+                                                      value, last);
+}
+
+// Replaces the members of an extended json value, output from the start of its frame, by the value they represent.
+template <typename Container, json_parse_policy Policy>
+element_type basic_json_reader<Container, Policy>::close_extended(const frame& f) {
+    const auto members = m_members.data() + f.members;
+    const auto count = m_members.size() - f.members;
+    const auto idx = f.start;
+
+    const auto find = [&](extended_key k, element_type t) -> const extended_member* {
+        for(size_t i = 0; i < count; ++i)
+            if(members[i].key == k)
+                return members[i].type == t ? &members[i] : nullptr;
+        return nullptr;
+    };
+    const auto string_at = [this](const extended_member* m) {
+        const auto size = detail::little_endian_to_native<int32_t>(std::next(m_data.begin(), m->offset), m_data.end());
+        return std::string(m_data.data() + m->offset + sizeof(int32_t), size - 1);
+    };
+    const auto integer_at = [this](const extended_member* m) -> int64_t {
+        const auto it = std::next(m_data.begin(), m->offset);
+        if(m->type == element_type::int32_element)
+            return detail::little_endian_to_native<int32_t>(it, m_data.end());
+        return detail::little_endian_to_native<int64_t>(it, m_data.end());
+    };
+    const auto rewrite = [this, idx](auto&& val) {
+        m_data.resize(idx);
+        auto out = m_data.end();
+        detail::serialise(m_data, out, val);
+    };
+    const auto fail = [this](const char* expected) {
+        m_rejected = expected;
+        return element_type::null_element;
+    };
+
+    auto type = element_type::null_element;
+    switch(members[0].key) {
+        case extended_key::oid: {
+            std::array<char, 12> oid;
+            const auto str = find(extended_key::oid, element_type::string_element);
+            if(count != 1 || !str || !parse_oid(string_at(str), oid))
+                return fail("oid element");
+            rewrite(oid);
+            type = element_type::oid_element;
+        } break;
+        case extended_key::date: {
+            auto date = find(extended_key::date, element_type::int64_element);
+            if(!date)
+                date = find(extended_key::date, element_type::int32_element);
+            if(count != 1 || !date)
+                return fail("date element");
+            rewrite(static_cast<detail::ElementTypeMap<element_type::date_element, element::container_type>>(
+                integer_at(date)));
+            type = element_type::date_element;
+        } break;
+        case extended_key::number_long: {
+            const auto str = find(extended_key::number_long, element_type::string_element);
+            int64_t val;
+            if(count != 1 || !str || !boost::conversion::try_lexical_convert(string_at(str), val))
+                return fail("64-bit integer");
+            rewrite(val);
+            type = element_type::int64_element;
+        } break;
+        case extended_key::timestamp: {
+            const auto doc = find(extended_key::timestamp, element_type::document_element);
+            if(count != 1 || !doc)
+                return fail("timestamp element");
+            const basic_document<range_type> ts{std::next(m_data.begin(), doc->offset), m_data.end()};
+            const auto t = ts.find("t"), i = ts.find("i");
+            if(boost::distance(ts) != 2 || t == ts.end() || i == ts.end() ||
+               !(t->type() == element_type::int32_element || t->type() == element_type::int64_element) ||
+               !(i->type() == element_type::int32_element || i->type() == element_type::int64_element))
+                return fail("timestamp element");
+            const auto t_val = t->type() == element_type::int32_element ? get<element_type::int32_element>(*t)
+                                                                         : get<element_type::int64_element>(*t);
+            const auto i_val = i->type() == element_type::int32_element ? get<element_type::int32_element>(*i)
+                                                                         : get<element_type::int64_element>(*i);
+            rewrite(static_cast<int64_t>(static_cast<uint64_t>(t_val) << 32 | static_cast<uint32_t>(i_val)));
+            type = element_type::timestamp_element;
+        } break;
+        case extended_key::regex:
+        case extended_key::options: {
+            const auto re = find(extended_key::regex, element_type::string_element);
+            const auto options = find(extended_key::options, element_type::string_element);
+            if(count != 2 || !re || !options)
+                return fail("regex element");
+            rewrite(std::make_tuple(string_at(re), string_at(options)));
+            type = element_type::regex_element;
+        } break;
+        case extended_key::ref:
+        case extended_key::id: {
+            const auto ref = find(extended_key::ref, element_type::string_element);
+            std::array<char, 12> oid;
+            if(const auto id = find(extended_key::id, element_type::oid_element))
+                std::copy_n(std::next(m_data.begin(), id->offset), oid.size(), oid.begin());
+            else if(const auto id = find(extended_key::id, element_type::string_element)) {
+                if(!parse_oid(string_at(id), oid))
+                    return fail("oid element");
+            } else
+                return fail("ref element");
+            if(count != 2 || !ref)
+                return fail("ref element");
+            rewrite(std::make_tuple(string_at(ref), oid));
+            type = element_type::db_pointer_element;
+        } break;
+        case extended_key::undefined:
+            if(count != 1)
+                return fail("undefined element");
+            m_data.resize(idx);
+            type = element_type::undefined_element;
+            break;
+        case extended_key::min_key:
+            if(count != 1)
+                return fail("minkey element");
+            m_data.resize(idx);
+            type = element_type::min_key;
+            break;
+        case extended_key::max_key:
+            if(count != 1)
+                return fail("maxkey element");
+            m_data.resize(idx);
+            type = element_type::max_key;
+            break;
+        case extended_key::binary:
+        case extended_key::type: {
+            // either {"$binary": "<base64>", "$type": "<hex>"}, or {"$binary": {"base64": ..., "subType": ...}}
+            std::string base64, subtype;
+            if(const auto str = find(extended_key::binary, element_type::string_element)) {
+                const auto sub = find(extended_key::type, element_type::string_element);
+                if(count != 2 || !sub)
+                    return fail("binary element");
+                base64 = string_at(str);
+                subtype = string_at(sub);
+            } else if(const auto doc = find(extended_key::binary, element_type::document_element)) {
+                if(count != 1)
+                    return fail("binary element");
+                const basic_document<range_type> bin{std::next(m_data.begin(), doc->offset), m_data.end()};
+                const auto data = bin.find("base64"), sub = bin.find("subType");
+                if(boost::distance(bin) != 2 || data == bin.end() || sub == bin.end() ||
+                   data->type() != element_type::string_element || sub->type() != element_type::string_element)
+                    return fail("binary element");
+                base64 = get<element_type::string_element>(*data).to_string();
+                subtype = get<element_type::string_element>(*sub).to_string();
+            } else
+                return fail("binary element");
+
+            std::string bytes;
+            if(subtype.empty() || subtype.size() > 2 ||
+               !std::all_of(subtype.begin(), subtype.end(), [](char c) { return detail::isxdigit(c); }) ||
+               !decode_base64(base64, bytes))
+                return fail("binary element");
+            const auto sub = static_cast<char>(std::strtoul(subtype.c_str(), nullptr, 16));
+            m_data.resize(idx);
+            // the old binary subtype repeats the length of its bytes within them
+            const auto old_binary = sub == 0x02;
+            append_value(static_cast<int32_t>(bytes.size() + (old_binary ? sizeof(int32_t) : 0)));
+            append(sub);
+            if(old_binary)
+                append_value(static_cast<int32_t>(bytes.size()));
+            append(bytes.begin(), bytes.end());
+            type = element_type::binary_element;
+        } break;
+        default:
+            return fail("extended json value");
+    }
+    return type;
+}
 } // namespace detail
 
-template <typename StringT> document read_json(StringT&& str) {
-    detail::json_reader reader{};
+/*!
+ * \brief Parses a JSON document.
+ *
+ * \tparam Policy json_parse_policy::trusted skips checking that \p str is well-formed.
+ * \throws json_parse_error when the input is malformed or isn't an object.
+ */
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT>
+document read_json(StringT&& str) {
+    detail::basic_json_reader<std::vector<char>, Policy> reader{};
+    reader.parse(std::forward<StringT>(str));
+
+    return std::move(reader);
+}
+
+//! Parses a JSON array. \sa read_json()
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT>
+array read_json_array(StringT&& str) {
+    detail::basic_json_reader<std::vector<char>, Policy> reader{};
     reader.parse(std::forward<StringT>(str));
 
     return std::move(reader);
 }
 
-template <typename StringT> array read_json_array(StringT&& str) {
-    detail::json_reader reader{};
+/*!
+ * \brief Parses a JSON document or array straight into a document_set, without building BSON for the whole first.
+ * \sa detail::basic_json_reader::parse_into()
+ */
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT>
+document_set read_json_set(StringT&& str) {
+    document_set set;
+    detail::basic_json_reader<std::vector<char>, Policy> reader{};
+    reader.parse_into(set, std::forward<StringT>(str));
+    return set;
+}
+
+/*!
+ * \brief Parses only the members of a JSON document at \p paths, and the objects containing them.
+ *
+ * Everything else is skipped without being decoded, so selecting a few members of a large document is far cheaper
+ * than parsing the whole.
+ * \sa detail::basic_json_reader::project() for how paths are written and matched.
+ * \throws json_parse_error when the input is malformed or isn't an object.
+ */
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT, typename ForwardRange>
+document read_json_projected(StringT&& str, const ForwardRange& paths) {
+    detail::basic_json_reader<std::vector<char>, Policy> reader{};
+    reader.project(paths);
     reader.parse(std::forward<StringT>(str));
 
     return std::move(reader);
 }
 
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT>
+document read_json_projected(StringT&& str, std::initializer_list<std::experimental::string_view> paths) {
+    return read_json_projected<Policy, StringT, decltype(paths)>(std::forward<StringT>(str), paths);
+}
+
+/*!
+ * \brief Parses a JSON document without throwing when the input is malformed.
+ *
+ * \return The document, or none with why not set in \p error.
+ * \sa read_json()
+ */
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT>
+boost::optional<document> try_read_json(StringT&& str, json_error& error) {
+    detail::basic_json_reader<std::vector<char>, Policy> reader{};
+    if(!reader.parse(std::forward<StringT>(str), error))
+        return boost::none;
+    return document(std::move(reader));
+}
+
+//! Parses a JSON array without throwing when the input is malformed. \sa try_read_json()
+template <json_parse_policy Policy = json_parse_policy::validating, typename StringT>
+boost::optional<array> try_read_json_array(StringT&& str, json_error& error) {
+    detail::basic_json_reader<std::vector<char>, Policy> reader{};
+    if(!reader.parse(std::forward<StringT>(str), error))
+        return boost::none;
+    return array(std::move(reader));
+}
+
+/*!
+ * \brief Parses JSON, reporting each value to \p handler rather than building a document.
+ *
+ * Nothing is output, so a handler which only computes something from its input needn't allocate.
+ * \sa detail::json_parser for the events handled, which a parser can also be reused for.
+ * \throws json_parse_error when the input is malformed or isn't an object or array, or the handler rejects it.
+ */
+template <json_parse_policy Policy = json_parse_policy::validating, typename ForwardRange, typename Handler>
+void parse_json(ForwardRange&& range, Handler&& handler) {
+    detail::basic_json_parser<Policy> parser;
+    parser.parse(handler, std::forward<ForwardRange>(range));
+}
+
+/*!
+ * \brief Parses JSON into \p handler without throwing when the input is malformed or the handler rejects it.
+ * \return Whether the input was parsed, otherwise why not is set in \p error.
+ * \sa parse_json(), detail::json_parser for how a handler can reject input without throwing.
+ */
+template <json_parse_policy Policy = json_parse_policy::validating, typename ForwardRange, typename Handler>
+bool try_parse_json(ForwardRange&& range, Handler&& handler, json_error& error) {
+    detail::basic_json_parser<Policy> parser;
+    return parser.parse(handler, std::forward<ForwardRange>(range), error);
+}
+
 struct[[deprecated("Use read_json()")]] json_reader : detail::json_reader {
     using detail::json_reader::json_reader;
 };
@@ -887,6 +2617,9 @@ std::basic_ostream<CharT, TraitsT>& operator<<(std::basic_ostream<CharT, TraitsT
         case json_error_num::unexpected_token:
             os << "unexpected token";
             break;
+        case json_error_num::nesting_too_deep:
+            os << "objects or arrays nested too deeply";
+            break;
         default:
             os << "unknown error";
     }
@@ -931,9 +2664,10 @@ inline std::string error_message(json_parse_error& err) {
 inline namespace literal {
 
 inline document_set operator"" _json_set(const char* str, size_t len) {
+    document_set set;
     json_reader reader;
-    reader.parse(str, str + len);
-    return document_set(basic_document<std::vector<char>, std::vector<char>>(std::move(reader)));
+    reader.parse_into(set, str, str + len);
+    return set;
 }
 
 inline document operator"" _json_doc(const char* str, size_t len) {
@@ -949,9 +2683,10 @@ inline array operator"" _json_arr(const char* str, size_t len) {
 }
 
 inline document_set operator"" _json_set(const wchar_t* str, size_t len) {
+    document_set set;
     json_reader reader;
-    reader.parse(str, str + len);
-    return document_set(basic_document<std::vector<char>, std::vector<char>>(std::move(reader)));
+    reader.parse_into(set, str, str + len);
+    return set;
 }
 
 inline document operator"" _json_doc(const wchar_t* str, size_t len) {
@@ -967,9 +2702,10 @@ inline array operator"" _json_arr(const wchar_t* str, size_t len) {
 }
 
 inline document_set operator"" _json_set(const char16_t* str, size_t len) {
+    document_set set;
     json_reader reader;
-    reader.parse(str, str + len);
-    return document_set(basic_document<std::vector<char>, std::vector<char>>(std::move(reader)));
+    reader.parse_into(set, str, str + len);
+    return set;
 }
 
 inline document operator"" _json_doc(const char16_t* str, size_t len) {
@@ -985,9 +2721,10 @@ inline array operator"" _json_arr(const char16_t* str, size_t len) {
 }
 
 inline document_set operator"" _json_set(const char32_t* str, size_t len) {
+    document_set set;
     json_reader reader;
-    reader.parse(str, str + len);
-    return document_set(basic_document<std::vector<char>, std::vector<char>>(std::move(reader)));
+    reader.parse_into(set, str, str + len);
+    return set;
 }
 
 inline document operator"" _json_doc(const char32_t* str, size_t len) {
@@ -0,0 +1,99 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_STREAM_READER_HPP
+#define JBSON_JSON_STREAM_READER_HPP
+
+#include <functional>
+#include <iterator>
+#include <memory>
+
+#include "json_reader.hpp"
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+
+/*!
+ * \brief Incremental JSON reader, fed UTF-8 input in arbitrarily split chunks.
+ *
+ * The input is a sequence of top-level JSON objects or arrays, optionally separated by whitespace.
+ * Each is passed to the handler as a document as soon as the chunk containing its closing bracket is fed.
+ * Parsing resumes where the last chunk ended: the BSON of a value is built as its chunks arrive, with its open
+ * containers kept between calls, so the input needn't be held in memory. Only a string, number or literal split between
+ * chunks is buffered.
+ *
+ * Errors are reported by throwing json_parse_error, with positions relative to the start of the input.
+ * After an exception, whether thrown by the parser or the handler, the reader must be reset() before it's fed again.
+ */
+struct json_stream_reader {
+    //! Called with each document as it's completed.
+    using handler_type = std::function<void(document)>;
+
+    explicit json_stream_reader(handler_type handler) : m_handler(std::move(handler)) {
+    }
+
+    /*!
+     * \brief Feeds the next chunk of input, emitting any values it completes.
+     * \throws json_parse_error when a value is malformed or isn't an object or array.
+     */
+    void feed(const char* first, const char* last);
+
+    //! Feeds a contiguous range of `char`, e.g. a std::string or std::vector<char>.
+    template <typename ContiguousRange_> void feed(ContiguousRange_&& range_) {
+        auto range = boost::as_literal(std::forward<ContiguousRange_>(range_));
+        static_assert(detail::is_iterator_pointer<decltype(std::begin(range))>::value,
+                      "json_stream_reader can only be fed contiguous ranges");
+        if(!boost::empty(range))
+            feed(std::addressof(*std::begin(range)), std::addressof(*std::begin(range)) + boost::size(range));
+    }
+
+    /*!
+     * \brief Signals the end of input.
+     * \throws json_parse_error when a value has been started but not closed.
+     */
+    void finish() {
+        m_parser.finish();
+    }
+
+    //! Discards any partially fed value, making the reader ready for new input.
+    void reset() noexcept {
+        m_parser.reset_stream();
+        m_reader.reset();
+    }
+
+    //! Number of bytes of input buffered for a string, number or literal split between chunks.
+    size_t buffered() const noexcept {
+        return m_parser.buffered();
+    }
+
+    //! Sets how deeply objects and arrays may be nested. \sa detail::basic_json_parser::max_depth()
+    void max_depth(size_t depth) noexcept {
+        m_parser.max_depth(depth);
+    }
+
+  private:
+    handler_type m_handler;
+    detail::json_parser m_parser;
+    // the handler of m_parser's events, building the BSON of the value being fed
+    detail::json_reader m_reader;
+};
+
+inline void json_stream_reader::feed(const char* first, const char* last) {
+    while(first != last) {
+        bool closed;
+        first = m_parser.feed(m_reader, first, last, closed);
+        if(!closed)
+            return;
+        m_handler(std::move(m_reader));
+        m_reader.reset();
+    }
+}
+
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_STREAM_READER_HPP
@@ -0,0 +1,474 @@
+//          Copyright Christian Manning 2014.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef JBSON_JSON_STRUCT_READER_HPP
+#define JBSON_JSON_STRUCT_READER_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <experimental/string_view>
+
+#include "json_reader.hpp"
+
+JBSON_PUSH_DISABLE_DEPRECATED_WARNING
+
+namespace jbson {
+
+/*!
+ * \brief Maps the members of a user-defined type \p T to the keys of the JSON objects it's read from.
+ *
+ * Specialise with a static constexpr function `fields()`, returning a std::tuple of json_field(), e.g.
+ *
+ *     namespace jbson {
+ *     template <> struct json_fields<point> {
+ *         static constexpr auto fields() {
+ *             return std::make_tuple(JBSON_JSON_FIELD(point, x), json_field("label", &point::name));
+ *         }
+ *     };
+ *     }
+ *
+ * Members may be `bool`, arithmetic, std::string, boost::optional or std::vector of those, or other mapped types.
+ * \sa read_json_struct()
+ */
+template <typename T> struct json_fields {};
+
+//! A member of \p Class, and the key it's read from.
+template <typename Class, typename Member> struct json_field_t {
+    std::experimental::string_view name;
+    Member Class::*member;
+};
+
+//! Maps the key \p name to \p member. \sa json_fields
+template <typename Class, typename Member, size_t N>
+constexpr json_field_t<Class, Member> json_field(const char (&name)[N], Member Class::*member) {
+    return {{name, N - 1}, member};
+}
+
+//! Maps a member to a key of the same name. \sa json_fields
+#define JBSON_JSON_FIELD(Class, member) ::jbson::json_field(#member, &Class::member)
+
+namespace detail {
+
+// Largest table searched for a perfect hash of n keys, loose enough that one is quickly found.
+constexpr size_t key_hash_capacity(size_t n) {
+    size_t size = 8;
+    while(size < n * 8)
+        size *= 2;
+    return size;
+}
+
+/*!
+ * \brief A perfect hash of a fixed set of keys, found at compile time.
+ *
+ * Each key hashes to a distinct slot of a power-of-two sized table, so finding one takes a single hash and comparison.
+ */
+template <size_t N> struct key_hash {
+    static constexpr size_t capacity = key_hash_capacity(N);
+
+    //! Index of the key named \p key, or N when there's none.
+    size_t find(std::experimental::string_view key) const noexcept {
+        const auto idx = slots[hash(key, seed) & mask];
+        return idx < N && names[idx] == key ? idx : N;
+    }
+
+    static constexpr uint32_t hash(std::experimental::string_view key, uint32_t seed) noexcept {
+        // FNV-1a
+        uint32_t h = 2166136261u ^ seed;
+        for(size_t i = 0; i < key.size(); ++i) {
+            h ^= static_cast<unsigned char>(key[i]);
+            h *= 16777619u;
+        }
+        return h ^ h >> 16;
+    }
+
+    uint32_t seed;
+    uint32_t mask;
+    size_t slots[capacity];
+    std::experimental::string_view names[N ? N : 1];
+};
+
+template <size_t N> constexpr size_t key_hash<N>::capacity;
+
+template <typename... Names> constexpr key_hash<sizeof...(Names)> make_key_hash(Names... names_) {
+    constexpr auto n = sizeof...(Names);
+    const std::experimental::string_view names[] = {{}, names_...};
+    key_hash<n> table{};
+    for(size_t i = 0; i < n; ++i)
+        table.names[i] = names[i + 1];
+
+    for(size_t size = 2; size <= table.capacity; size *= 2) {
+        for(uint32_t seed = 0; seed < 64; ++seed) {
+            for(auto& slot : table.slots)
+                slot = n;
+            bool ok = true;
+            for(size_t i = 0; i < n && ok; ++i) {
+                auto& slot = table.slots[table.hash(table.names[i], seed) & (size - 1)];
+                ok = slot == n;
+                slot = i;
+            }
+            if(ok) {
+                table.seed = seed;
+                table.mask = static_cast<uint32_t>(size - 1);
+                return table;
+            }
+        }
+    }
+    throw std::invalid_argument("json field names must be distinct");
+}
+
+struct value_ops;
+
+//! Somewhere a JSON value is read into, and how.
+struct value_target {
+    void* ptr;
+    const value_ops* ops;
+};
+
+/*!
+ * \brief How each kind of JSON value is read into some type, or null where it can't be.
+ *
+ * The functions for objects & arrays return where their members & elements are read into, which is then passed to
+ * \p member or \p element for each of them.
+ */
+struct value_ops {
+    //! What's expected, for error messages.
+    const char* name;
+    void (*string)(void*, std::experimental::string_view);
+    void (*integer)(void*, int64_t);
+    void (*real)(void*, double);
+    void (*boolean)(void*, bool);
+    void (*null)(void*);
+    value_target (*object)(void*);
+    value_target (*array)(void*);
+    //! Where the member named by its argument is read into, or a null target when it's to be skipped.
+    value_target (*member)(void*, std::experimental::string_view);
+    //! Where the next element is read into.
+    value_target (*element)(void*);
+};
+
+[[noreturn]] inline void throw_value_error(const char* expected) {
+    BOOST_THROW_EXCEPTION(json_parse_error{} << parse_error(json_error_num::unexpected_token)
+                                             << expected_token(expected));
+}
+
+template <typename T, typename Enable = void> struct value_reader {
+    static_assert(sizeof(T) == 0, "JSON can't be read into this type. Does it need a json_fields specialisation?");
+};
+
+//! The value_ops of \p T.
+template <typename T> struct value_ops_of {
+    static constexpr value_ops table = value_reader<T>::ops();
+};
+
+template <typename T> constexpr value_ops value_ops_of<T>::table;
+
+template <typename T> value_target make_target(T& val) noexcept {
+    return {std::addressof(val), &value_ops_of<T>::table};
+}
+
+template <> struct value_reader<bool> {
+    static void boolean(void* p, bool val) {
+        *static_cast<bool*>(p) = val;
+    }
+
+    static constexpr value_ops ops() {
+        return {"bool", nullptr, nullptr, nullptr, &boolean, nullptr, nullptr, nullptr, nullptr, nullptr};
+    }
+};
+
+template <typename T>
+struct value_reader<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>> {
+    static void integer(void* p, int64_t val) {
+        // only values which survive the round trip fit
+        if((!std::is_signed<T>::value && val < 0) || static_cast<int64_t>(static_cast<T>(val)) != val)
+            throw_value_error("integer in range");
+        *static_cast<T*>(p) = static_cast<T>(val);
+    }
+
+    static constexpr value_ops ops() {
+        return {"integer", nullptr, &integer, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    }
+};
+
+template <typename T> struct value_reader<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static void integer(void* p, int64_t val) {
+        *static_cast<T*>(p) = static_cast<T>(val);
+    }
+    static void real(void* p, double val) {
+        *static_cast<T*>(p) = static_cast<T>(val);
+    }
+
+    static constexpr value_ops ops() {
+        return {"number", nullptr, &integer, &real, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    }
+};
+
+template <typename Traits, typename Allocator> struct value_reader<std::basic_string<char, Traits, Allocator>> {
+    static void string(void* p, std::experimental::string_view str) {
+        static_cast<std::basic_string<char, Traits, Allocator>*>(p)->assign(str.data(), str.size());
+    }
+
+    static constexpr value_ops ops() {
+        return {"string", &string, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    }
+};
+
+template <typename T, typename Allocator> struct value_reader<std::vector<T, Allocator>> {
+    static_assert(!std::is_same<T, bool>::value, "JSON can't be read into std::vector<bool>");
+
+    static value_target array(void* p) {
+        static_cast<std::vector<T, Allocator>*>(p)->clear();
+        return {p, &value_ops_of<std::vector<T, Allocator>>::table};
+    }
+    static value_target element(void* p) {
+        auto& vec = *static_cast<std::vector<T, Allocator>*>(p);
+        vec.emplace_back();
+        return make_target(vec.back());
+    }
+
+    static constexpr value_ops ops() {
+        return {"array", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &array, nullptr, &element};
+    }
+};
+
+/*
+ * Whether value_reader<T> reads each kind of value, found from the functions it defines.
+ * An optional reads whatever its value does.
+ * These are types rather than tests of the pointers in value_ops, as comparing a function pointer to null isn't a
+ * constant expression everywhere, e.g. under GCC's -fno-delete-null-pointer-checks.
+ */
+#define JBSON_VALUE_READER_READS(fun)                                                                                  \
+    template <typename T, typename Enable = void> struct defines_##fun : std::false_type {};                          \
+    template <typename T>                                                                                              \
+    struct defines_##fun<T, decltype(void(&value_reader<T>::fun))> : std::true_type {};                               \
+    template <typename T> struct reads_##fun : defines_##fun<T> {};                                                    \
+    template <typename T> struct reads_##fun<boost::optional<T>> : reads_##fun<T> {};
+
+JBSON_VALUE_READER_READS(string)
+JBSON_VALUE_READER_READS(integer)
+JBSON_VALUE_READER_READS(real)
+JBSON_VALUE_READER_READS(boolean)
+JBSON_VALUE_READER_READS(object)
+JBSON_VALUE_READER_READS(array)
+
+#undef JBSON_VALUE_READER_READS
+
+// null resets an optional; anything else is read into a new value.
+template <typename T> struct value_reader<boost::optional<T>> {
+    static void* engage(void* p) {
+        auto& opt = *static_cast<boost::optional<T>*>(p);
+        opt.emplace();
+        return std::addressof(*opt);
+    }
+
+    static void string(void* p, std::experimental::string_view str) {
+        value_ops_of<T>::table.string(engage(p), str);
+    }
+    static void integer(void* p, int64_t val) {
+        value_ops_of<T>::table.integer(engage(p), val);
+    }
+    static void real(void* p, double val) {
+        value_ops_of<T>::table.real(engage(p), val);
+    }
+    static void boolean(void* p, bool val) {
+        value_ops_of<T>::table.boolean(engage(p), val);
+    }
+    static void null(void* p) {
+        static_cast<boost::optional<T>*>(p)->reset();
+    }
+    static value_target object(void* p) {
+        return value_ops_of<T>::table.object(engage(p));
+    }
+    static value_target array(void* p) {
+        return value_ops_of<T>::table.array(engage(p));
+    }
+
+    // fun where the value's type reads that kind of value, else null
+    template <typename Reads, typename Fun> static constexpr Fun either(Fun fun) {
+        return Reads::value ? fun : nullptr;
+    }
+
+    static constexpr value_ops ops() {
+        return {value_reader<T>::ops().name,
+                either<reads_string<T>>(&string),
+                either<reads_integer<T>>(&integer),
+                either<reads_real<T>>(&real),
+                either<reads_boolean<T>>(&boolean),
+                &null,
+                either<reads_object<T>>(&object),
+                either<reads_array<T>>(&array),
+                nullptr,
+                nullptr};
+    }
+};
+
+// Members are found by a perfect hash of their keys. Unknown keys are skipped.
+template <typename T> struct value_reader<T, decltype(json_fields<T>::fields(), void())> {
+    using fields_type = decltype(json_fields<T>::fields());
+    static constexpr size_t size = std::tuple_size<fields_type>::value;
+
+    template <size_t... I> static constexpr key_hash<size> make_hash(std::index_sequence<I...>) {
+        return make_key_hash(std::get<I>(json_fields<T>::fields()).name...);
+    }
+
+    template <size_t I> static value_target field(void* p) {
+        return make_target(static_cast<T*>(p)->*std::get<I>(json_fields<T>::fields()).member);
+    }
+
+    template <size_t... I> static value_target field(void* p, size_t idx, std::index_sequence<I...>) {
+        static constexpr value_target (*fields[])(void*) = {nullptr, &field<I>...};
+        return fields[idx + 1](p);
+    }
+
+    static value_target object(void* p) {
+        return {p, &value_ops_of<T>::table};
+    }
+    static value_target member(void* p, std::experimental::string_view name) {
+        static constexpr auto hash = make_hash(std::make_index_sequence<size>{});
+        const auto idx = hash.find(name);
+        if(idx == size)
+            return {nullptr, nullptr};
+        return field(p, idx, std::make_index_sequence<size>{});
+    }
+
+    static constexpr value_ops ops() {
+        return {"object", nullptr, nullptr, nullptr, nullptr, nullptr, &object, nullptr, &member, nullptr};
+    }
+};
+
+/*!
+ * \brief Handles the events of a json_parser by reading values straight into C++ objects.
+ *
+ * Values of unknown keys are skipped by the parser, without being decoded.
+ * Throws json_parse_error for a value of the wrong type.
+ */
+struct value_handler {
+    //! Starts reading into \p root.
+    void reset(value_target root) noexcept {
+        m_root = root;
+        m_next = {nullptr, nullptr};
+        m_frames.clear();
+    }
+
+    void start_object() {
+        const auto target = next();
+        m_frames.push_back({check(target, target.ops->object)(target.ptr), false});
+    }
+    void end_object() {
+        m_frames.pop_back();
+    }
+    void start_array() {
+        const auto target = next();
+        m_frames.push_back({check(target, target.ops->array)(target.ptr), true});
+    }
+    void end_array() {
+        end_object();
+    }
+    void key(std::experimental::string_view name) {
+        const auto& obj = m_frames.back().target;
+        m_next = obj.ops->member(obj.ptr, name);
+    }
+    //! Skips the value of a key without a field.
+    bool skip_value(bool) const noexcept {
+        return !m_next.ptr;
+    }
+    void string_value(std::experimental::string_view str) {
+        const auto target = next();
+        check(target, target.ops->string)(target.ptr, str);
+    }
+    void int32_value(int32_t val) {
+        int64_value(val);
+    }
+    void int64_value(int64_t val) {
+        const auto target = next();
+        check(target, target.ops->integer)(target.ptr, val);
+    }
+    void double_value(double val) {
+        const auto target = next();
+        check(target, target.ops->real)(target.ptr, val);
+    }
+    void bool_value(bool val) {
+        const auto target = next();
+        check(target, target.ops->boolean)(target.ptr, val);
+    }
+    void null_value() {
+        const auto target = next();
+        check(target, target.ops->null)(target.ptr);
+    }
+
+  private:
+    struct frame {
+        value_target target;
+        bool array;
+    };
+
+    // where the value starting now is read into
+    value_target next() {
+        if(m_frames.empty())
+            return m_root;
+        const auto& top = m_frames.back();
+        if(top.array)
+            return top.target.ops->element(top.target.ptr);
+        return m_next;
+    }
+
+    template <typename Fun> static Fun check(const value_target& target, Fun fun) {
+        if(!fun)
+            throw_value_error(target.ops->name);
+        return fun;
+    }
+
+    value_target m_root{nullptr, nullptr};
+    value_target m_next{nullptr, nullptr};
+    std::vector<frame> m_frames;
+};
+
+} // namespace detail
+
+/*!
+ * \brief Parses JSON straight into objects of a user-defined type \p T, without building BSON.
+ *
+ * Object members are matched to fields by json_fields<T>; those without one are skipped.
+ * Members absent from the JSON are left as they were.
+ * A reader can be reused, and needn't allocate once warmed up.
+ *
+ * \tparam Policy Whether input is checked to be well-formed, or is trusted to be.
+ */
+template <typename T, json_parse_policy Policy = json_parse_policy::validating> struct json_struct_reader {
+    /*!
+     * \brief Parses \p range into \p out.
+     * \throws json_parse_error when the input is malformed, or a value's type doesn't match its field's.
+     */
+    template <typename ForwardRange> void parse(ForwardRange&& range, T& out) {
+        m_handler.reset(detail::make_target(out));
+        m_parser.parse(m_handler, std::forward<ForwardRange>(range));
+    }
+
+  private:
+    detail::basic_json_parser<Policy> m_parser;
+    detail::value_handler m_handler;
+};
+
+/*!
+ * \brief Parses JSON into a new value-initialised \p T. \sa json_struct_reader
+ * \throws json_parse_error when the input is malformed, or a value's type doesn't match its field's.
+ */
+template <typename T, json_parse_policy Policy = json_parse_policy::validating, typename ForwardRange>
+T read_json_struct(ForwardRange&& range) {
+    T out{};
+    json_struct_reader<T, Policy>{}.parse(std::forward<ForwardRange>(range), out);
+    return out;
+}
+
+} // namespace jbson
+
+JBSON_POP_WARNINGS
+
+#endif // JBSON_JSON_STRUCT_READER_HPP
@@ -11,6 +11,7 @@ using namespace std::literals;
 #include <jbson/document.hpp>
 #include <jbson/builder.hpp>
 #include <jbson/json_reader.hpp>
+#include <jbson/json_builder.hpp>
 using namespace jbson;
 
 #include <gtest/gtest.h>
@@ -97,6 +98,27 @@ TEST(BuilderTest, ArrayBuildTest1) {
     ASSERT_EQ(it, end);
 }
 
+TEST(BuilderTest, ArrayBuildTest2) {
+    array_builder arrb;
+    for(int32_t i = 0; i < 12345; ++i)
+        arrb(i);
+    const auto arr = array(arrb);
+    EXPECT_TRUE(arr.valid(validity_level::array_indices));
+
+    int32_t i = 0;
+    for(auto&& e : arr) {
+        ASSERT_EQ(std::to_string(i), e.name());
+        ASSERT_EQ(i++, get<element_type::int32_element>(e));
+    }
+    for(auto idx : {0, 9, 10, 99, 100, 999, 1000, 1009, 12344}) {
+        const auto it = arr.find(idx);
+        ASSERT_NE(arr.end(), it);
+        EXPECT_EQ(idx, get<element_type::int32_element>(*it));
+    }
+    EXPECT_EQ(arr.end(), arr.find(12345));
+    EXPECT_EQ(arr.end(), arr.find(-1));
+}
+
 TEST(BuilderTest, BuildNestTest1) {
     document doc;
     doc = document(builder("hello", element_type::string_element, "world")(
@@ -332,3 +354,20 @@ TEST(BuilderTest, BuildNestTest5) {
     it++;
     ASSERT_EQ(it, doc.end());
 }
+
+TEST(BuilderTest, BuildJsonTest1) {
+    const auto payload = R"({"id": 1, "tags": ["a", "b"], "when": {"$date": 1418000000000}})"s;
+    const document doc = builder("topic", "orders")("payload", json_text{payload})("list", json_text{" [1, {}]"});
+    EXPECT_EQ(document(builder("topic", "orders")("payload", read_json(payload))(
+                  "list", element_type::array_element, read_json_array("[1, {}]"s))),
+              doc);
+
+    const array arr = array_builder(1)(json_text{"{}"})(json_text{"[]"});
+    EXPECT_EQ(read_json_array("[1, {}, []]"s), arr);
+
+    // a failed parse leaves the builder as it was
+    auto build = builder("a", 1);
+    EXPECT_THROW(build("b", json_text{R"({"x": )"}), json_parse_error);
+    EXPECT_THROW(build("b", json_text{"2"}), json_parse_error);
+    EXPECT_EQ(document(builder("a", 1)), document(build));
+}
@@ -3,7 +3,9 @@
 //    (See accompanying file LICENSE_1_0.txt or copy at
 //          http://www.boost.org/LICENSE_1_0.txt)
 
+#include <cstring>
 #include <fstream>
+#include <list>
 #include <string>
 using namespace std::literals;
 
@@ -13,6 +15,12 @@ using namespace std::literals;
 
 #define private public
 #include <jbson/json_reader.hpp>
+#include <jbson/json_stream_reader.hpp>
+#include <jbson/json_file_reader.hpp>
+#include <jbson/json_lines_reader.hpp>
+#include <jbson/json_parallel_reader.hpp>
+#include <jbson/json_struct_reader.hpp>
+#include <jbson/json_lazy_reader.hpp>
 using namespace jbson;
 
 TEST(JsonReaderTest, JsonParseTest1) {
@@ -819,3 +827,1026 @@ TEST(JsonReaderTest, JsonCheckerPass3) {
 
     EXPECT_NO_THROW(read_json(json));
 }
+
+TEST(JsonReaderTest, JsonIndexedParseTest1) {
+    std::ifstream ifs{JBSON_FILES "/json_checker_test_suite/pass1.json", std::ios::in};
+    auto json = std::vector<char>{};
+    ifs.seekg(0, std::ios::end);
+    auto n = static_cast<std::streamoff>(ifs.tellg());
+    json.resize(n);
+    ifs.seekg(0, std::ios::beg);
+    ifs.read(json.data(), n);
+    ASSERT_GE(json.size(), size_t{detail::structural_index::min_input_size});
+
+    // contiguous input is indexed, a list isn't
+    detail::json_reader indexed, unindexed;
+    ASSERT_NO_THROW(indexed.parse(json));
+    const auto list = std::list<char>(json.begin(), json.end());
+    ASSERT_NO_THROW(unindexed.parse(list));
+    EXPECT_EQ(unindexed.m_data, indexed.m_data);
+}
+
+TEST(JsonReaderTest, JsonIndexedParseTest2) {
+    auto json = R"({"a": ")" + std::string(300, 'x') + "\",\n  \"b\"  :  [1,  2,\n\n  3 4]}"s;
+    const auto list = std::list<char>(json.begin(), json.end());
+    try {
+        read_json(json);
+        FAIL() << "expected json_parse_error";
+    } catch(json_parse_error& e) {
+        ASSERT_NE(nullptr, boost::get_error_info<detail::line_number>(e));
+        EXPECT_EQ(4u, *boost::get_error_info<detail::line_number>(e));
+        EXPECT_EQ(5u, *boost::get_error_info<detail::line_position>(e));
+        EXPECT_EQ("  3 4]}", *boost::get_error_info<detail::current_line_string>(e));
+    }
+    try {
+        read_json(list);
+        FAIL() << "expected json_parse_error";
+    } catch(json_parse_error& e) {
+        EXPECT_EQ(4u, *boost::get_error_info<detail::line_number>(e));
+        EXPECT_EQ(5u, *boost::get_error_info<detail::line_position>(e));
+    }
+}
+
+TEST(JsonReaderTest, JsonIndexedParseTest3) {
+    // a null ends a name, leaving the index out of step with the parser
+    auto json = "{\"a\0 \": 1, \"b\":  \""s + std::string(300, 'x') + "\"}";
+    EXPECT_THROW(read_json(json), json_parse_error);
+    json = "{\"a\0: 1, \"b\":  \""s + std::string(300, 'x') + "\"}";
+    auto doc = document{};
+    ASSERT_NO_THROW(doc = read_json(json));
+    EXPECT_EQ(2, boost::distance(doc));
+}
+
+TEST(JsonReaderTest, JsonWhitespaceRunTest1) {
+    // runs either side of the vector widths, in input too small to be indexed
+    const auto ws = " \t\n\r\v\f"s;
+    for(size_t n = 0; n < 60; n++) {
+        std::string run;
+        for(size_t i = 0; i < n; i++)
+            run += ws[i % ws.size()];
+        const auto json = "[" + run + "1" + run + "," + run + "true" + run + "]";
+        ASSERT_LT(json.size(), size_t{detail::structural_index::min_input_size});
+        auto arr = array{};
+        ASSERT_NO_THROW(arr = read_json_array(json)) << n;
+        ASSERT_EQ(2, boost::distance(arr));
+        EXPECT_EQ(1, arr.begin()->value<int32_t>());
+    }
+}
+
+TEST(JsonReaderTest, JsonWhitespaceRunTest2) {
+    const auto json = "[" + std::string(40, ' ') + "\n\n" + std::string(40, ' ') + "x]";
+    try {
+        read_json_array(json);
+        FAIL() << "expected json_parse_error";
+    } catch(json_parse_error& e) {
+        EXPECT_EQ(3u, *boost::get_error_info<detail::line_number>(e));
+        EXPECT_EQ(41u, *boost::get_error_info<detail::line_position>(e));
+    }
+}
+
+TEST(JsonReaderTest, JsonStringUtf8Test1) {
+    // long enough to be scanned in blocks, with multi-byte characters either side of the block boundaries
+    const auto str = std::string(30, 'a') + "\xC3\xA9" + std::string(29, 'b') + "\xE2\x82\xAC\xF0\x9D\x84\x9E" +
+                     std::string(40, 'c') + "\\n\\u00e9" + std::string(20, 'd');
+    const auto expected = std::string(30, 'a') + "\xC3\xA9" + std::string(29, 'b') + "\xE2\x82\xAC\xF0\x9D\x84\x9E" +
+                          std::string(40, 'c') + "\n\xC3\xA9" + std::string(20, 'd');
+    const auto json = "[\"" + str + "\"]";
+    auto arr = array{};
+    ASSERT_NO_THROW(arr = read_json_array(json));
+    ASSERT_EQ(1, boost::distance(arr));
+    EXPECT_EQ(expected, get<element_type::string_element>(*arr.begin()));
+
+    const auto list = std::list<char>(json.begin(), json.end());
+    ASSERT_NO_THROW(arr = read_json_array(list));
+    EXPECT_EQ(expected, get<element_type::string_element>(*arr.begin()));
+}
+
+TEST(JsonReaderTest, JsonStringUtf8Test2) {
+    const std::string invalid[] = {
+        "\xFF",             // never valid
+        "\x80",             // lone continuation
+        "\xC0\xAF",         // overlong
+        "\xE0\x80\xAF",     // overlong
+        "\xED\xA0\x80",     // surrogate
+        "\xF4\x90\x80\x80", // beyond U+10FFFF
+        "\xE2\x82",         // truncated
+    };
+    // small and indexed input
+    for(size_t n : {40, 300})
+        for(auto&& seq : invalid) {
+            const auto json = "[\"" + std::string(n, 'a') + seq + std::string(n, 'b') + "\"]";
+            try {
+                read_json_array(json);
+                FAIL() << "expected json_parse_error";
+            } catch(json_parse_error& e) {
+                EXPECT_EQ(n + 3, *boost::get_error_info<detail::line_position>(e));
+            }
+            EXPECT_THROW(read_json_array(std::list<char>(json.begin(), json.end())), json_parse_error);
+        }
+}
+
+TEST(JsonReaderTest, JsonNumberTest1) {
+    auto arr = array{};
+    ASSERT_NO_THROW(arr = read_json_array(
+                        R"([2147483646, 2147483647, -9223372036854775808, -01, 1e-400, 1.7976931348623157e308,
+                            9007199254740993.0, 2.4703282292062327e-324, 0.1, 123456789012345678901234567890.5])"s));
+    auto it = arr.begin();
+    ASSERT_EQ(element_type::int32_element, it->type());
+    EXPECT_EQ(2147483646, get<element_type::int32_element>(*it++));
+    ASSERT_EQ(element_type::int64_element, it->type());
+    EXPECT_EQ(2147483647, get<element_type::int64_element>(*it++));
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), get<element_type::int64_element>(*it++));
+    EXPECT_EQ(-1, get<element_type::int32_element>(*it++));
+    EXPECT_EQ(0.0, get<element_type::double_element>(*it++));
+    EXPECT_EQ(std::numeric_limits<double>::max(), get<element_type::double_element>(*it++));
+    // correctly rounded, halfway cases to even
+    EXPECT_EQ(9007199254740992.0, get<element_type::double_element>(*it++));
+    EXPECT_EQ(0.0, get<element_type::double_element>(*it++));
+    EXPECT_EQ(0.1, get<element_type::double_element>(*it++));
+    EXPECT_EQ(1.2345678901234568e29, get<element_type::double_element>(*it++));
+    EXPECT_EQ(arr.end(), it);
+}
+
+TEST(JsonReaderTest, JsonNumberTest2) {
+    for(auto&& num : {"00", "01", "0e5", "1.", "1.e5", "-.5", "-", "1e", "1e+", "1-2", "1.5.5", "1e5e5", "1e400",
+                      "1.7976931348623159e308", "9223372036854775808", "-9223372036854775809", "1a"})
+        EXPECT_THROW(read_json_array("["s + num + "]"), json_parse_error) << num;
+}
+
+TEST(JsonReaderTest, JsonStreamTest1) {
+    const auto json = R"( {"a": "x}\"{", "b": [1, {"c": 2.5}]}
+[true, null, "\\"] {"d": {"e": [[], {}]}, "f": "é"}   )"s;
+    const std::vector<document> expected{read_json(R"({"a": "x}\"{", "b": [1, {"c": 2.5}]})"s),
+                                         read_json(R"([true, null, "\\"])"s),
+                                         read_json(R"({"d": {"e": [[], {}]}, "f": "é"})"s)};
+
+    // every possible split into three chunks
+    for(size_t i = 0; i <= json.size(); ++i) {
+        for(size_t j = i; j <= json.size(); j += 7) {
+            std::vector<document> docs;
+            json_stream_reader reader{[&](document doc) { docs.push_back(std::move(doc)); }};
+            ASSERT_NO_THROW(reader.feed(json.data(), json.data() + i));
+            ASSERT_NO_THROW(reader.feed(json.substr(i, j - i)));
+            ASSERT_NO_THROW(reader.feed(json.substr(j)));
+            ASSERT_NO_THROW(reader.finish());
+            EXPECT_EQ(0, reader.buffered());
+            ASSERT_EQ(expected.size(), docs.size()) << i << " " << j;
+            for(size_t k = 0; k < docs.size(); ++k)
+                EXPECT_EQ(expected[k].data(), docs[k].data()) << i << " " << j;
+        }
+    }
+}
+
+TEST(JsonReaderTest, JsonStreamTest2) {
+    size_t count = 0;
+    json_stream_reader reader{[&](document) { ++count; }};
+
+    // documents are emitted as soon as they close, and only a token split between chunks is buffered
+    reader.feed(R"({"a": 1} {"b": )");
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(0, reader.buffered());
+    reader.feed(R"([12)");
+    EXPECT_EQ(2, reader.buffered());
+    reader.feed(R"(3, "xy)");
+    EXPECT_EQ(3, reader.buffered());
+    reader.feed("z\\");
+    EXPECT_EQ(5, reader.buffered());
+    reader.feed(R"(n"]})");
+    EXPECT_EQ(2, count);
+    EXPECT_EQ(0, reader.buffered());
+
+    reader.feed(R"({"c": [1, 2)");
+    EXPECT_THROW(reader.finish(), json_parse_error);
+    reader.reset();
+
+    EXPECT_THROW(reader.feed(R"({"c": 1,})"), json_parse_error);
+    reader.reset();
+    EXPECT_THROW(reader.feed(R"({} 1)"), json_parse_error);
+    reader.reset();
+    EXPECT_EQ(3, count);
+
+    reader.feed(R"([1)");
+    reader.feed(R"(] [2])");
+    reader.finish();
+    EXPECT_EQ(5, count);
+}
+
+TEST(JsonReaderTest, JsonStreamTest3) {
+    // one large value, fed a few bytes at a time, is built as it arrives rather than buffered
+    std::string json = R"({"items": [)";
+    for(int i = 0; i < 2000; ++i)
+        json += (i ? ", " : "") + R"({"id": )"s + std::to_string(i) + R"(, "name": "item \u00e9 )" +
+                std::to_string(i) + R"(", "ok": true, "x": -1.5e3, "n": null})";
+    json += "]}";
+    const auto expected = read_json(json);
+
+    for(size_t chunk : {1, 3, 64}) {
+        std::vector<document> docs;
+        json_stream_reader reader{[&](document doc) { docs.push_back(std::move(doc)); }};
+        size_t max_buffered = 0;
+        for(size_t i = 0; i < json.size(); i += chunk) {
+            reader.feed(json.substr(i, chunk));
+            max_buffered = std::max(max_buffered, reader.buffered());
+        }
+        reader.finish();
+        ASSERT_EQ(1, docs.size());
+        EXPECT_EQ(expected.data(), docs[0].data());
+        EXPECT_GT(32, max_buffered);
+    }
+}
+
+TEST(JsonReaderTest, JsonStreamTest4) {
+    json_stream_reader reader{[](document) {}};
+    const auto position = [&](std::initializer_list<const char*> chunks) {
+        reader.reset();
+        try {
+            for(auto chunk : chunks)
+                reader.feed(chunk);
+            reader.finish();
+        } catch(json_parse_error& e) {
+            EXPECT_NE(nullptr, boost::get_error_info<detail::line_number>(e));
+            EXPECT_NE(nullptr, boost::get_error_info<detail::line_position>(e));
+            return std::make_tuple(*boost::get_error_info<detail::parse_error>(e),
+                                   *boost::get_error_info<detail::line_number>(e),
+                                   *boost::get_error_info<detail::line_position>(e));
+        }
+        ADD_FAILURE() << "expected json_parse_error";
+        return std::make_tuple(json_error_num::unexpected_token, size_t{0}, size_t{0});
+    };
+
+    // errors are located in the input as a whole, whichever chunk they're found in
+    EXPECT_EQ(std::make_tuple(json_error_num::invalid_root_element, 2u, 4u), position({"{}\n", "  ", " 1"}));
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_token, 3u, 10u),
+              position({"[1,\n", "2,\n  [tr", "ue,", " nul]]"}));
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_token, 1u, 10u), position({R"({"a": "\)", R"(x"})"}));
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_token, 1u, 9u), position({R"({"a": "b)", "\n\"}"}));
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_end_of_range, 2u, 4u), position({"{\"a\"", ":\n [1"}));
+
+    reader.reset();
+    reader.max_depth(2);
+    EXPECT_NO_THROW(reader.feed("[[]]"));
+    EXPECT_THROW(reader.feed("[[["), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonLinesTest1) {
+    std::string json;
+    std::vector<document> expected;
+    for(int i = 0; i < 20000; ++i) {
+        const auto line = R"({"id": )" + std::to_string(i) + R"(, "v": ["a\nb", {"x": )" + std::to_string(i * 0.5) +
+                          "}]}";
+        json += (i % 3 ? "" : "  \r\n") + line + "\r\n";
+        expected.push_back(read_json(line));
+    }
+    json += R"({"id": "bad",})";
+    json += "\n[]";
+
+    for(unsigned threads : {1, 4}) {
+        auto lines = read_json_lines(json, json_lines_format::lines, threads);
+        ASSERT_EQ(expected.size() + 2, lines.documents.size());
+        EXPECT_EQ(expected, std::vector<document>(lines.documents.begin(), lines.documents.end() - 2));
+        EXPECT_EQ(document{}, lines.documents[expected.size()]);
+        EXPECT_EQ(5, lines.documents.back().size());
+        ASSERT_EQ(1, lines.errors.size());
+        EXPECT_EQ(expected.size(), lines.errors[0].record);
+        EXPECT_EQ(json.size() - 17, lines.errors[0].offset);
+        EXPECT_EQ(14, *boost::get_error_info<detail::line_position>(lines.errors[0].error));
+
+        auto arena = read_json_lines_arena(json, json_lines_format::lines, threads);
+        ASSERT_EQ(expected.size() + 2, arena.size());
+        for(size_t i = 0; i < expected.size(); ++i)
+            ASSERT_EQ(expected[i], arena[i]);
+        EXPECT_EQ(document{}, arena[expected.size()]);
+        ASSERT_EQ(1, arena.errors.size());
+        EXPECT_EQ(expected.size(), arena.errors[0].record);
+    }
+}
+
+TEST(JsonReaderTest, JsonLinesTest2) {
+    auto seq = read_json_lines("\x1e{\"a\":\n 1}\n\x1e\n\x1e[2]\n\x1e{]\n"s, json_lines_format::sequence);
+    ASSERT_EQ(3, seq.documents.size());
+    EXPECT_EQ(read_json(R"({"a": 1})"), seq.documents[0]);
+    EXPECT_EQ(read_json(R"([2])"), seq.documents[1]);
+    ASSERT_EQ(1, seq.errors.size());
+    EXPECT_EQ(2, seq.errors[0].record);
+
+    auto cat = read_json_lines("{\"a\":\n \"}\"}[2]{}\n 3 [\n4\n]"s, json_lines_format::concatenated);
+    ASSERT_EQ(5, cat.documents.size());
+    EXPECT_EQ(read_json(R"({"a": "}"})"), cat.documents[0]);
+    EXPECT_EQ(read_json(R"([2])"), cat.documents[1]);
+    EXPECT_EQ(read_json(R"([4])"), cat.documents[4]);
+    ASSERT_EQ(1, cat.errors.size());
+    EXPECT_EQ(3, cat.errors[0].record);
+    EXPECT_EQ(json_error_num::invalid_root_element, *boost::get_error_info<detail::parse_error>(cat.errors[0].error));
+}
+
+TEST(JsonReaderTest, JsonBatchTest1) {
+    std::vector<std::string> messages;
+    for(int i = 0; i < 1000; ++i)
+        messages.push_back(R"({"id": )" + std::to_string(i) + R"(, "topic": "orders", "v": [1.5, {"x": "y"}]})");
+    messages.push_back("");
+    messages.push_back("{}");
+    messages.push_back(R"({"a": })");
+
+    const auto batch = read_json_batch(messages);
+    ASSERT_EQ(messages.size(), batch.size());
+    for(size_t i = 0; i < 1000; ++i)
+        ASSERT_EQ(read_json(messages[i]), batch[i]);
+    EXPECT_EQ(document{}, batch[1000]);
+    EXPECT_EQ(5, batch[1001].size());
+    EXPECT_EQ(document{}, batch[1002]);
+    ASSERT_EQ(2, batch.errors.size());
+    EXPECT_EQ(1000, batch.errors[0].record);
+    EXPECT_EQ(json_error_num::unexpected_end_of_range,
+              *boost::get_error_info<detail::parse_error>(batch.errors[0].error));
+    EXPECT_EQ(1002, batch.errors[1].record);
+
+    EXPECT_EQ(batch.data.size(), batch.offsets.back() + 5);
+
+    std::vector<boost::iterator_range<const char*>> ranges{boost::as_literal(R"({"a": 1})"), boost::as_literal("[2]")};
+    const auto views = read_json_batch(ranges);
+    ASSERT_EQ(2, views.size());
+    EXPECT_TRUE(boost::equal(read_json_array("[2]"s).data(), views[1].data()));
+}
+
+TEST(JsonReaderTest, JsonParallelArrayTest1) {
+    std::string objects = "[", numbers = "[", strings = "[";
+    for(int i = 0; i < 40000; ++i) {
+        objects += R"({"id": )" + std::to_string(i) + R"(, "v": [{"x": 1}, {"y": "a, b"}], "$s": "}, {"},)" + "\n";
+        for(int j = 0; j < 8; ++j) {
+            numbers += std::to_string(i * 1.5) + ", ";
+            strings += R"("a, b", )";
+        }
+    }
+    objects += "{}]";
+    numbers += "0]";
+    strings += "\"\"]";
+
+    for(auto&& json : {objects, numbers, strings}) {
+        const auto expected = read_json_array(json);
+        const auto arr = read_json_array_parallel(json, 4);
+        EXPECT_EQ(expected.data(), arr.data());
+    }
+
+    // splits inside strings are caught, and the array parsed again
+    std::string quoted = "[\"";
+    for(int i = 0; i < 100000; ++i)
+        quoted += R"(}, {\"a\": 1}, {\"b\": 2}, )";
+    quoted += "\"]";
+    EXPECT_EQ(read_json_array(quoted).data(), read_json_array_parallel(quoted, 4).data());
+
+    // as are splits between the elements of a nested array
+    std::string nested = R"([{"v": [)";
+    for(int i = 0; i < 200000; ++i)
+        nested += R"({"x": 1}, )";
+    nested += R"({"x": 2}]}, {"y": 3}])";
+    const auto middle = nested.data() + nested.size() / 2;
+    const auto split = detail::find_array_split(middle, nested.data() + nested.size(), '{');
+    ASSERT_NE(nullptr, split);
+    EXPECT_EQ(nested.find(R"({"x": 1})", middle - nested.data()), static_cast<size_t>(split - nested.data() + 1));
+    const auto nested_arr = read_json_array_parallel(nested, 4);
+    EXPECT_EQ(read_json_array(nested).data(), nested_arr.data());
+    EXPECT_EQ(2, boost::distance(nested_arr));
+
+    objects.back() = ',';
+    EXPECT_THROW(read_json_array_parallel(objects, 4), json_parse_error);
+    objects.back() = ']';
+    objects.insert(objects.size() / 2, "}");
+    EXPECT_THROW(read_json_array_parallel(objects, 4), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonErrorPositionTest1) {
+    // positions are recovered after the fact for all kinds of input
+    const auto json = "{\"a\":\n\n   [1, 2, {\"x\": nul}]}"s;
+    const auto check = [](auto&& input) {
+        try {
+            read_json(input);
+            FAIL() << "expected json_parse_error";
+        } catch(json_parse_error& e) {
+            EXPECT_EQ(3, *boost::get_error_info<detail::line_number>(e));
+            EXPECT_EQ(17, *boost::get_error_info<detail::line_position>(e));
+            EXPECT_EQ("   [1, 2, {\"x\": nul}]}", *boost::get_error_info<detail::current_line_string>(e));
+        }
+    };
+    check(json);
+    check(std::list<char>(json.begin(), json.end()));
+    check(std::u16string(json.begin(), json.end()));
+    check(std::u32string(json.begin(), json.end()));
+}
+
+TEST(JsonReaderTest, JsonExtendedTest1) {
+    auto doc = read_json(R"({"date": {"$date": 1412345678901}, "re": {"$options": "i", "$regex": "a.*"},
+                             "ref": {"$ref": "coll", "$id": {"$oid": "507f1f77bcf86cd799439011"}},
+                             "long": {"$numberLong": "-9000000000"}, "small": {"$date": {"$numberLong": "5"}},
+                             "ts": {"$timestamp": {"t": 7, "i": 3}}, "min": {"$minKey": 1}, "max": {"$maxkey": 1},
+                             "undef": {"$undefined": true}, "other": {"$other": 1, "$oid": 2}})"s);
+    auto it = doc.begin();
+    ASSERT_EQ(element_type::date_element, it->type());
+    EXPECT_EQ(1412345678901, it++->value<int64_t>());
+    ASSERT_EQ(element_type::regex_element, it->type());
+    EXPECT_EQ(std::make_tuple("a.*"s, "i"s), get<element_type::regex_element>(*it++));
+    ASSERT_EQ(element_type::db_pointer_element, it->type());
+    auto ref = get<element_type::db_pointer_element>(*it++);
+    EXPECT_EQ("coll", std::get<0>(ref));
+    EXPECT_EQ(0x50, std::get<1>(ref)[0]);
+    EXPECT_EQ(0x11, std::get<1>(ref)[11]);
+    ASSERT_EQ(element_type::int64_element, it->type());
+    EXPECT_EQ(-9000000000, get<element_type::int64_element>(*it++));
+    ASSERT_EQ(element_type::date_element, it->type());
+    EXPECT_EQ(5, it++->value<int64_t>());
+    ASSERT_EQ(element_type::timestamp_element, it->type());
+    EXPECT_EQ(int64_t{7} << 32 | 3, get<element_type::timestamp_element>(*it++));
+    EXPECT_EQ(element_type::min_key, it++->type());
+    EXPECT_EQ(element_type::max_key, it++->type());
+    EXPECT_EQ(element_type::undefined_element, it++->type());
+    ASSERT_EQ(element_type::document_element, it->type());
+    EXPECT_EQ(2, boost::distance(get<element_type::document_element>(*it++)));
+    EXPECT_EQ(doc.end(), it);
+}
+
+TEST(JsonReaderTest, JsonExtendedTest2) {
+    for(auto&& json : {R"({"a": {"$oid": "507f1f77bcf86cd79943901g"}})", R"({"a": {"$oid": "507f", "x": 1}})",
+                       R"({"a": {"$oid": "507f1f77bcf86cd799439011", "$id": 1}})", R"({"a": {"$date": "1"}})",
+                       R"({"a": {"$regex": "a"}})", R"({"a": {"$regex": "a", "$regex": "b"}})",
+                       R"({"a": {"$numberLong": "1x"}})", R"({"a": {"$ref": "c", "$id": 1}})",
+                       R"({"a": {"$timestamp": {"t": 1}}})", R"({"a": {"$minKey": 1, "$maxKey": 1}})"})
+        EXPECT_THROW(read_json(std::string{json}), json_parse_error) << json;
+}
+
+TEST(JsonReaderTest, JsonExtendedTest3) {
+    const auto binary_doc = [](char subtype, std::string bytes) {
+        auto len = static_cast<int32_t>(bytes.size());
+        if(subtype == 0x02)
+            bytes.insert(0, reinterpret_cast<const char*>(&len), sizeof(len));
+        auto outer = static_cast<int32_t>(bytes.size());
+        std::vector<char> data(sizeof(int32_t));
+        boost::push_back(data, "\x05""a\0"s);
+        data.insert(data.end(), reinterpret_cast<const char*>(&outer), reinterpret_cast<const char*>(&outer + 1));
+        data.push_back(subtype);
+        boost::push_back(data, bytes);
+        data.push_back('\0');
+        const auto size = static_cast<int32_t>(data.size());
+        std::copy_n(reinterpret_cast<const char*>(&size), sizeof(size), data.begin());
+        return data;
+    };
+
+    EXPECT_EQ(binary_doc(0x00, "foobar"), read_json(R"({"a": {"$binary": "Zm9vYmFy", "$type": "00"}})"s).data());
+    EXPECT_EQ(binary_doc(0x80, "fo"), read_json(R"({"a": {"$type": "80", "$binary": "Zm8="}})"s).data());
+    EXPECT_EQ(binary_doc(0x05, "f"), read_json(R"({"a": {"$binary": {"base64": "Zg==", "subType": "5"}}})"s).data());
+    EXPECT_EQ(binary_doc(0x02, "foo"), read_json(R"({"a": {"$binary": "Zm9v", "$type": "02"}})"s).data());
+    EXPECT_EQ(binary_doc(0x00, ""), read_json(R"({"a": {"$binary": "", "$type": "0"}})"s).data());
+
+    for(auto&& json :
+        {R"({"a": {"$binary": "Zm9vYmFy"}})", R"({"a": {"$type": "00"}})", R"({"a": {"$binary": "Zm9v", "$type": 0}})",
+         R"({"a": {"$binary": "Zm9", "$type": "00"}})", R"({"a": {"$binary": "Zm=v", "$type": "00"}})",
+         R"({"a": {"$binary": "Zm9v", "$type": "100"}})", R"({"a": {"$binary": "Zm9v", "$type": "0g"}})",
+         R"({"a": {"$binary": "Zm9v", "$type": ""}})", R"({"a": {"$binary": "Zm9v", "$type": "00", "x": 1}})",
+         R"({"a": {"$binary": {"base64": "Zm9v"}}})", R"({"a": {"$binary": {"base64": "Zm9v", "subType": 0}}})",
+         R"({"a": {"$binary": {"base64": "Zm9v", "subType": "00"}, "$type": "00"}})"})
+        EXPECT_THROW(read_json(std::string{json}), json_parse_error) << json;
+}
+
+TEST(JsonReaderTest, JsonWideStringTest1) {
+    const auto utf8 = u8R"({"ascii run longer than a vector": "é, ߿, 😀 and then plenty more ascii", "k": "é"})"s;
+    std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> cvt16;
+    std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> cvt32;
+    const auto expected = read_json(utf8);
+    EXPECT_EQ(expected.data(), read_json(cvt16.from_bytes(utf8)).data());
+    EXPECT_EQ(expected.data(), read_json(cvt32.from_bytes(utf8)).data());
+
+    EXPECT_THROW(read_json(u"[\"a lone high surrogate \xd800 here\"]"s), json_parse_error);
+    EXPECT_THROW(read_json(u"[\"a lone low surrogate \xdc00 here\"]"s), json_parse_error);
+    EXPECT_THROW(read_json(U"[\"out of range \x110000 here\"]"s), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonReaderReuseTest1) {
+    detail::json_reader reader;
+    reader.parse(R"({"a": "a fairly long string value", "b": [1, 2, 3]})"s);
+    const auto data = reader.data().data();
+    const auto capacity = reader.data().capacity();
+
+    reader.parse(R"({"c": 1})"s);
+    EXPECT_EQ(data, reader.data().data());
+    EXPECT_EQ(capacity, reader.data().capacity());
+    EXPECT_EQ(read_json(R"({"c": 1})"s).data(), document(reader).data());
+
+    reader.reset();
+    EXPECT_TRUE(reader.data().empty());
+    EXPECT_EQ(capacity, reader.data().capacity());
+
+    EXPECT_THROW(reader.parse(R"({"c": })"s), json_parse_error);
+    reader.parse(R"([true])"s);
+    EXPECT_EQ(read_json_array(R"([true])"s).data(), array(reader).data());
+
+    document doc = std::move(reader);
+    EXPECT_EQ(doc.data().size(), doc.data().capacity());
+}
+
+TEST(JsonReaderTest, JsonReaderParseIntoTest1) {
+    detail::json_reader reader;
+    std::vector<char> out{'x'};
+    reader.parse_into(out, R"({"a": 1})"s);
+    reader.parse_into(out, R"([2])"s);
+    EXPECT_TRUE(reader.data().empty());
+
+    const auto a = read_json(R"({"a": 1})"s).data();
+    const auto b = read_json_array(R"([2])"s).data();
+    ASSERT_EQ(1 + a.size() + b.size(), out.size());
+    EXPECT_EQ('x', out.front());
+    EXPECT_TRUE(std::equal(a.begin(), a.end(), out.begin() + 1));
+    EXPECT_TRUE(std::equal(b.begin(), b.end(), out.begin() + 1 + a.size()));
+
+    EXPECT_THROW(reader.parse_into(out, R"({"a": [1, })"s), json_parse_error);
+    EXPECT_EQ(1 + a.size() + b.size(), out.size());
+}
+
+namespace {
+size_t allocations = 0;
+
+template <typename T> struct counting_allocator : std::allocator<T> {
+    template <typename U> struct rebind { using other = counting_allocator<U>; };
+
+    counting_allocator() = default;
+    template <typename U> counting_allocator(const counting_allocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        ++allocations;
+        return std::allocator<T>::allocate(n);
+    }
+};
+} // namespace
+
+TEST(JsonReaderTest, JsonReaderAllocatorTest1) {
+    using container = std::vector<char, counting_allocator<char>>;
+    detail::basic_json_reader<container> reader{counting_allocator<char>{}};
+    allocations = 0;
+    reader.parse(R"({"a": [1, 2, 3], "b": {"c": "d"}})"s);
+    EXPECT_LT(0u, allocations);
+    const auto doc = basic_document<container>(std::move(reader));
+    EXPECT_EQ(2, boost::distance(doc));
+    EXPECT_EQ("d", get<element_type::string_element>(*doc.find("b")->value<basic_document<container>>().find("c")));
+}
+
+namespace {
+struct event_recorder {
+    void start_object() {
+        events += "{";
+    }
+    void end_object() {
+        events += "}";
+    }
+    void start_array() {
+        events += "[";
+    }
+    void end_array() {
+        events += "]";
+    }
+    void key(std::experimental::string_view str) {
+        events += "k:" + str.to_string() + " ";
+    }
+    void string_value(std::experimental::string_view str) {
+        events += "s:" + str.to_string() + " ";
+    }
+    void int32_value(int32_t val) {
+        events += "i:" + std::to_string(val) + " ";
+    }
+    void int64_value(int64_t val) {
+        events += "l:" + std::to_string(val) + " ";
+    }
+    void double_value(double val) {
+        events += "d:" + std::to_string(val) + " ";
+    }
+    void bool_value(bool val) {
+        events += val ? "true " : "false ";
+    }
+    void null_value() {
+        if(reject_null)
+            BOOST_THROW_EXCEPTION(json_parse_error{} << detail::parse_error(json_error_num::unexpected_token));
+        events += "null ";
+    }
+
+    std::string events;
+    bool reject_null = false;
+};
+} // namespace
+
+TEST(JsonReaderTest, JsonEventTest1) {
+    event_recorder handler;
+    parse_json(R"({"a": [1, 9000000000, 1.5, "x\ty", true, false, null], "b\"": {"$oid": {}}})"s, handler);
+    EXPECT_EQ("{k:a [i:1 l:9000000000 d:1.500000 s:x\ty true false null ]k:b\" {k:$oid {}}}", handler.events);
+
+    handler.events.clear();
+    parse_json(std::list<char>{'[', '"', 'a', '"', ']'}, handler);
+    EXPECT_EQ("[s:a ]", handler.events);
+
+    handler.reject_null = true;
+    try {
+        parse_json("[1,\n null]"s, handler);
+        FAIL() << "expected json_parse_error";
+    } catch(json_parse_error& e) {
+        ASSERT_NE(nullptr, boost::get_error_info<detail::line_number>(e));
+        EXPECT_EQ(2u, *boost::get_error_info<detail::line_number>(e));
+    }
+    EXPECT_THROW(parse_json("[1, nul]"s, event_recorder{}), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonFileTest1) {
+    std::ifstream ifs{JBSON_FILES "/json_test_suite_sample.json"};
+    const std::string json{std::istreambuf_iterator<char>{ifs}, {}};
+    EXPECT_EQ(read_json(json).data(), read_json_file(JBSON_FILES "/json_test_suite_sample.json").data());
+
+    EXPECT_THROW(read_json_file(JBSON_FILES "/json_checker_test_suite/fail2.json"), json_parse_error);
+    EXPECT_THROW(read_json_array_file(JBSON_FILES "/json_checker_test_suite/missing.json"), json_file_error);
+    try {
+        read_json_file(JBSON_FILES "/json_checker_test_suite/missing.json");
+    } catch(json_file_error& e) {
+        ASSERT_NE(nullptr, boost::get_error_info<boost::errinfo_file_name>(e));
+        EXPECT_EQ(JBSON_FILES "/json_checker_test_suite/missing.json"s,
+                  *boost::get_error_info<boost::errinfo_file_name>(e));
+    }
+}
+
+#ifdef JBSON_MMAP
+TEST(JsonReaderTest, JsonFileTest2) {
+    // pipes can't be mapped, so are read instead
+    const auto path = "/tmp/jbson_json_file_test_"s + std::to_string(::getpid());
+    ASSERT_EQ(0, ::mkfifo(path.c_str(), 0600));
+    const auto json = "[" + std::string(100000, ' ') + "1, 2, 3]";
+    std::thread writer{[&] { std::ofstream{path} << json; }};
+    array arr;
+    EXPECT_NO_THROW(arr = read_json_array_file(path));
+    writer.join();
+    ::unlink(path.c_str());
+    EXPECT_EQ(read_json_array(json).data(), arr.data());
+}
+#endif // JBSON_MMAP
+
+TEST(JsonReaderTest, JsonTrustedTest1) {
+    std::ifstream ifs{JBSON_FILES "/json_test_suite_sample.json"};
+    const std::string json{std::istreambuf_iterator<char>{ifs}, {}};
+    EXPECT_EQ(read_json(json).data(), read_json<json_parse_policy::trusted>(json).data());
+
+    const auto str = R"(["aé𝄞", -0.5e-3, 10, 9000000000, true, false, null, {"b": []}])"s;
+    EXPECT_EQ(read_json_array(str).data(), read_json_array<json_parse_policy::trusted>(str).data());
+    EXPECT_EQ(read_json_array(std::u16string{str.begin(), str.end()}).data(),
+              read_json_array<json_parse_policy::trusted>(std::u16string{str.begin(), str.end()}).data());
+    EXPECT_EQ(read_json_array(std::list<char>{str.begin(), str.end()}).data(),
+              read_json_array<json_parse_policy::trusted>(std::list<char>{str.begin(), str.end()}).data());
+
+    // only structure is checked
+    EXPECT_THROW(read_json_array("[\"a\tb\", 01]"s), json_parse_error);
+    EXPECT_NO_THROW(read_json_array<json_parse_policy::trusted>("[\"a\tb\", 01]"s));
+    EXPECT_THROW(read_json_array<json_parse_policy::trusted>("[1, 2"s), json_parse_error);
+
+    // input cut short is caught without reading past its end
+    for(auto&& json : {"[t", "[fa", "[nul", "[1,tr", R"({"a":"\ud800)", R"({"a":"\u00)", R"({"a":"\ud800\u)"}) {
+        const std::vector<char> exact(json, json + std::strlen(json));
+        const auto error = [&](auto read) {
+            try {
+                read(exact);
+            } catch(json_parse_error& e) {
+                return *boost::get_error_info<detail::parse_error>(e);
+            }
+            return json_error_num::invalid_root_element;
+        };
+        EXPECT_EQ(json_error_num::unexpected_end_of_range, error([](auto&& r) { read_json(r); })) << json;
+        EXPECT_EQ(json_error_num::unexpected_end_of_range,
+                  error([](auto&& r) { read_json<json_parse_policy::trusted>(r); }))
+            << json;
+    }
+}
+
+namespace {
+struct struct_test_point {
+    int32_t x = 0;
+    double y = 0;
+    std::string name;
+};
+
+struct struct_test_shape {
+    std::vector<struct_test_point> points;
+    boost::optional<struct_test_point> centre;
+    boost::optional<int64_t> id;
+    uint8_t sides = 0;
+    bool closed = false;
+};
+} // namespace
+
+namespace jbson {
+template <> struct json_fields<struct_test_point> {
+    static constexpr auto fields() {
+        return std::make_tuple(JBSON_JSON_FIELD(struct_test_point, x), JBSON_JSON_FIELD(struct_test_point, y),
+                               json_field("label", &struct_test_point::name));
+    }
+};
+
+template <> struct json_fields<struct_test_shape> {
+    static constexpr auto fields() {
+        return std::make_tuple(JBSON_JSON_FIELD(struct_test_shape, points), JBSON_JSON_FIELD(struct_test_shape, centre),
+                               JBSON_JSON_FIELD(struct_test_shape, id), JBSON_JSON_FIELD(struct_test_shape, sides),
+                               JBSON_JSON_FIELD(struct_test_shape, closed));
+    }
+};
+} // namespace jbson
+
+TEST(JsonReaderTest, JsonStructTest1) {
+    const auto json = R"({"sides": 3, "extra": {"a": [1, {"b": null}]}, "points": [
+        {"x": 1, "y": 2.5, "label": "a\"b"}, {"y": 7, "z": [], "x": -4}, {}],
+        "closed": true, "id": null, "centre": {"x": 9}})"s;
+    const auto shape = read_json_struct<struct_test_shape>(json);
+    EXPECT_EQ(3, shape.sides);
+    EXPECT_TRUE(shape.closed);
+    EXPECT_FALSE(shape.id);
+    ASSERT_TRUE(shape.centre);
+    EXPECT_EQ(9, shape.centre->x);
+    ASSERT_EQ(3u, shape.points.size());
+    EXPECT_EQ(1, shape.points[0].x);
+    EXPECT_EQ(2.5, shape.points[0].y);
+    EXPECT_EQ("a\"b", shape.points[0].name);
+    EXPECT_EQ(-4, shape.points[1].x);
+    EXPECT_EQ(7.0, shape.points[1].y);
+    EXPECT_EQ(0, shape.points[2].x);
+
+    json_struct_reader<struct_test_point> reader;
+    struct_test_point pt;
+    reader.parse(R"({"x": 5})"s, pt);
+    reader.parse(std::list<char>{'{', '"', 'y', '"', ':', '1', '}'}, pt);
+    EXPECT_EQ(5, pt.x);
+    EXPECT_EQ(1.0, pt.y);
+
+    const auto points = read_json_struct<std::vector<struct_test_point>>(R"([{"x": 1}, {"x": 2}])"s);
+    ASSERT_EQ(2u, points.size());
+    EXPECT_EQ(2, points[1].x);
+    EXPECT_EQ(8, read_json_struct<struct_test_shape>(R"({"id": 8})"s).id.value_or(0));
+
+    // unknown members are skipped whatever they hold, even nested past the parser's depth limit
+    std::string unknown = R"({"x": 3, "unknown": )";
+    for(int i = 0; i < 2000; ++i)
+        unknown += R"({"a": [1.5, "s\"]}", {"b": null}, )";
+    unknown += "[]";
+    for(int i = 0; i < 2000; ++i)
+        unknown += "]}";
+    unknown += R"(, "y": 4})";
+    const auto skipped = read_json_struct<struct_test_point>(unknown);
+    EXPECT_EQ(3, skipped.x);
+    EXPECT_EQ(4.0, skipped.y);
+
+    EXPECT_THROW(read_json_struct<struct_test_point>(R"({"x": "1"})"s), json_parse_error);
+    EXPECT_THROW(read_json_struct<struct_test_point>(R"({"x": 1.5})"s), json_parse_error);
+    EXPECT_THROW(read_json_struct<struct_test_shape>(R"({"sides": 256})"s), json_parse_error);
+    EXPECT_THROW(read_json_struct<struct_test_shape>(R"({"points": {}})"s), json_parse_error);
+    EXPECT_THROW(read_json_struct<struct_test_shape>(R"({"closed": null})"s), json_parse_error);
+    EXPECT_THROW(read_json_struct<struct_test_point>(R"([])"s), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonStructTest2) {
+    using std::experimental::string_view;
+    constexpr auto hash = detail::make_key_hash(string_view{"a", 1}, string_view{"b", 1}, string_view{"ab", 2},
+                                                string_view{"", 0});
+    EXPECT_EQ(0u, hash.find("a"));
+    EXPECT_EQ(1u, hash.find("b"));
+    EXPECT_EQ(2u, hash.find("ab"));
+    EXPECT_EQ(3u, hash.find(""));
+    EXPECT_EQ(4u, hash.find("ba"));
+    EXPECT_EQ(0u, detail::make_key_hash().find("a"));
+}
+
+TEST(JsonReaderTest, JsonSetTest1) {
+    const auto json = R"({"b": {"x": [1, {"$oid": "507f1f77bcf86cd799439011"}]}, "a": "str",
+                          "c": {"$date": 5}, "a": null, "d": [], "e": 2.5})"s;
+    const auto expected = document_set(read_json(json));
+    auto set = read_json_set(json);
+    EXPECT_EQ(6u, set.size());
+    EXPECT_TRUE(boost::equal(expected, set));
+
+    EXPECT_TRUE(boost::equal(document_set(read_json(R"(["a", {}, 1])"s)), read_json_set(R"(["a", {}, 1])"s)));
+    EXPECT_TRUE(read_json_set("{}"s).empty());
+
+    // a reused reader adds to what's already there
+    detail::json_reader reader;
+    document_set out;
+    reader.parse_into(out, R"({"z": 1})"s);
+    reader.parse_into(out, R"({"y": true})"s);
+    EXPECT_EQ(2u, out.size());
+    EXPECT_EQ("y", out.begin()->name());
+    EXPECT_THROW(reader.parse_into(out, R"({"x": 1, "w": })"s), json_parse_error);
+    EXPECT_TRUE(reader.data().empty());
+    reader.parse(R"({"v": 1})"s);
+    EXPECT_EQ(read_json(R"({"v": 1})"s).data(), reader.data());
+}
+
+TEST(JsonReaderTest, JsonProjectionTest1) {
+    const auto json = R"({"id": 7, "skipped": {"a": [1, {"b": "}]\\\"["}], "c": -1.5e3}, "user": {"name": "Ada",
+                         "tags": ["x", "y"], "age": 36}, "when": {"$date": 1418000000000}, "scalar": 5,
+                         "list": [{"name": "z"}], "meta": {"tags": {"t": true}, "n": null}, "tail": "\u00e9"})"s;
+    const auto expected = read_json(R"({"id": 7, "user": {"name": "Ada"}, "when": {"$date": 1418000000000},
+                                        "meta": {"tags": {"t": true}}})"s);
+    const std::vector<std::string> paths{"id", "user.name", "when", "$.meta.tags", "scalar.x", "list.name", "no.x"};
+    EXPECT_EQ(expected, read_json_projected(json, paths));
+    // other input is projected the same, though skipped through its own iterators
+    std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> cvt;
+    EXPECT_EQ(expected, read_json_projected(cvt.from_bytes(json), paths));
+
+    // a member selected whole includes those below it
+    EXPECT_EQ(read_json(R"({"user": {"name": "Ada", "tags": ["x", "y"], "age": 36}})"s),
+              read_json_projected(json, {"user.tags", "user"}));
+    EXPECT_EQ(read_json(json), read_json_projected(json, {"$"}));
+    EXPECT_EQ(read_json(R"({"user": {}})"s), read_json_projected(json, {"user.missing"}));
+
+    detail::json_reader reader;
+    reader.project({"a"});
+    reader.parse(R"([{"a": 1, "b": {"c": [2]}}, {"b": 3}, 4])"s);
+    EXPECT_EQ(read_json_array(R"([{"a": 1}, {}, 4])"s), array(reader));
+
+    // large input is skipped by its structural index
+    std::string large = R"({"rows": [)";
+    for(int i = 0; i < 1000; ++i)
+        large += R"({"id": )" + std::to_string(i) + R"(, "s": "]\"}"},)";
+    large += R"({}], "total": 1000})";
+    reader.project({"total"});
+    reader.parse(large);
+    EXPECT_EQ(read_json(R"({"total": 1000})"s), document(reader));
+    reader.project(std::vector<std::string>{});
+    reader.parse(large);
+    EXPECT_EQ(read_json(large), document(reader));
+
+    reader.project({"total"});
+    EXPECT_THROW(reader.parse(large.substr(0, large.size() - 30)), json_parse_error);
+    EXPECT_THROW(reader.parse(R"({"a": "unclosed, "total": 1})"s), json_parse_error);
+    EXPECT_THROW(reader.parse(R"({"a": , "total": 1})"s), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonTryReadTest1) {
+    json_error error;
+    const auto doc = try_read_json(R"({"a": [1, 2], "b": {"$oid": "507f1f77bcf86cd799439011"}})"s, error);
+    ASSERT_TRUE(!!doc);
+    EXPECT_FALSE(error);
+    EXPECT_EQ(read_json(R"({"a": [1, 2], "b": {"$oid": "507f1f77bcf86cd799439011"}})"s).data(), doc->data());
+
+    EXPECT_FALSE(try_read_json(R"({"a": [1, 2}, "b": 3})"s, error));
+    EXPECT_TRUE(error);
+    EXPECT_EQ(json_error_num::unexpected_token, error.num);
+    EXPECT_EQ(11u, error.offset);
+    EXPECT_STREQ(", or ]", error.expected);
+
+    EXPECT_FALSE(try_read_json(R"({"a": "\q"})"s, error));
+    EXPECT_EQ(9u, error.offset);
+    EXPECT_STREQ("valid control char", error.expected);
+    EXPECT_FALSE(try_read_json("  "s, error));
+    EXPECT_EQ(json_error_num::unexpected_end_of_range, error.num);
+    EXPECT_EQ(2u, error.offset);
+    EXPECT_FALSE(try_read_json_array(R"(["a", tru])"s, error));
+    EXPECT_EQ(6u, error.offset);
+    EXPECT_STREQ("true", error.expected);
+
+    // malformed extended json is reported like malformed json
+    EXPECT_FALSE(try_read_json(R"({"a": {"$oid": "xyz"}})"s, error));
+    EXPECT_EQ(json_error_num::unexpected_token, error.num);
+    EXPECT_EQ(20u, error.offset);
+    EXPECT_STREQ("oid element", error.expected);
+    EXPECT_FALSE(try_read_json(R"({"a": {"$oid": "507f1f77bcf86cd799439011", "b": 1}})"s, error));
+    EXPECT_STREQ("extended json value", error.expected);
+
+    // errors are found in the same place as those thrown
+    const auto json = u"{\"a\": 1,\n \"b\": [true, nul]}"s;
+    EXPECT_FALSE(try_read_json(json, error));
+    try {
+        read_json(json);
+        FAIL();
+    } catch(json_parse_error& e) {
+        ASSERT_NE(nullptr, boost::get_error_info<detail::line_position>(e));
+        EXPECT_EQ(json.find(u"nul"), error.offset);
+        EXPECT_EQ(json.find(u"nul") - json.find(u'\n'), *boost::get_error_info<detail::line_position>(e));
+    }
+
+    detail::json_reader reader;
+    EXPECT_FALSE(reader.parse("[1, 2"s, error));
+    EXPECT_TRUE(reader.parse("[1, 2]"s, error));
+    EXPECT_EQ(read_json_array("[1, 2]"s).data(), reader.data());
+}
+
+TEST(JsonReaderTest, JsonKeyShapeTest1) {
+    // keys are predicted from the last object at the same depth, which UTF-16 input never is
+    const auto json = R"([{"id": 1, "name": "a", "tags": {"x": 1}}, {"id": 2, "name": "b", "tags": {"x": 2, "y": 3}},
+                          {"id": 3, "nam": "c", "names": "d"}, {"id": 4, "id": 5, "name": ""},
+                          {"name": 6}, {"id": 7, "name": {"id": 8, "name": 9}}, {}, {"id": 10, "id": 11}])";
+    std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> cvt{};
+    const auto json16 = cvt.from_bytes(json);
+
+    detail::json_reader reader;
+    for(int i = 0; i < 2; ++i) {
+        reader.parse(boost::as_literal(json));
+        EXPECT_EQ(read_json_array(json16).data(), reader.data());
+    }
+    const auto arr = read_json_array(boost::as_literal(json));
+    ASSERT_EQ(8, boost::distance(arr));
+    const auto fourth = get<element_type::document_element>(*std::next(arr.begin(), 3));
+    EXPECT_EQ("id", fourth.begin()->name());
+
+    // a key mustn't be matched by a prediction it starts with, nor the reverse
+    for(const auto other : {R"([{"ab": 1}, {"a": 2}, {"abc": 3}, {"ab": 4}])",
+                            R"([{"a key longer than a vector": 1}, {"a key longer than a vector!": 2},
+                                {"a key longer than a vector": 3}, {"a key longer than a vector": 4}])"}) {
+        reader.parse(boost::as_literal(other));
+        EXPECT_EQ(read_json_array(cvt.from_bytes(other)).data(), reader.data());
+    }
+    EXPECT_THROW(reader.parse(R"([{"ab": 1}, {"ab)"s), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonDepthTest1) {
+    // nesting is limited by the parser's own stack, not the call stack
+    const auto deep = [](size_t depth) { return std::string(depth, '[') + "1" + std::string(depth, ']'); };
+    json_error error;
+    event_recorder handler;
+    detail::json_parser parser;
+    parser.max_depth(200000);
+    EXPECT_TRUE(parser.parse(handler, deep(200000), error));
+    EXPECT_FALSE(parser.parse(handler, deep(200001), error));
+    EXPECT_EQ(json_error_num::nesting_too_deep, error.num);
+    EXPECT_EQ(200000u, error.offset);
+
+    EXPECT_EQ(detail::json_parser::default_max_depth, detail::json_reader{}.max_depth());
+    EXPECT_TRUE(try_parse_json(deep(1024), event_recorder{}, error));
+    EXPECT_FALSE(try_parse_json(deep(1025), event_recorder{}, error));
+    EXPECT_THROW(read_json_array(deep(1025)), json_parse_error);
+
+    detail::json_reader reader;
+    reader.max_depth(2);
+    EXPECT_NO_THROW(reader.parse(R"({"a": [1], "b": {"c": 2}, "d": []})"s));
+    EXPECT_FALSE(reader.parse(R"({"a": [1], "b": {"c": {}}})"s, error));
+    EXPECT_EQ(json_error_num::nesting_too_deep, error.num);
+    EXPECT_EQ(22u, error.offset);
+}
+
+TEST(JsonReaderTest, JsonLazyTest1) {
+    const auto json = R"({"skipped": {"a": [1, {"b": "}]"}], "c": "\\\""}, "id": 42, "name\u0021": "x",
+                         "nested": {"deep": {"$oid": "507f1f77bcf86cd799439011"}, "n": [1, 2]}, "tail": [})"s;
+    const auto doc = read_json_lazy(json);
+    std::vector<std::string> names;
+    auto it = doc.begin();
+    for(; it != doc.end() && it->raw_name() != "tail"; ++it)
+        names.push_back(it->name());
+    EXPECT_EQ((std::vector<std::string>{"skipped", "id", "name!", "nested"}), names);
+    ASSERT_NE(doc.end(), it);
+    // values are only scanned as they're passed over, so the malformed one is found last
+    EXPECT_THROW(++it, json_parse_error);
+
+    const auto id = doc.find("id");
+    ASSERT_NE(doc.end(), id);
+    EXPECT_EQ("42", id->raw_value());
+    EXPECT_EQ(42, id->value<int32_t>());
+    EXPECT_EQ("x", doc.find("name!")->value<std::string>());
+    EXPECT_THROW(doc.find("missing"), json_parse_error);
+
+    const auto nested = doc.find("nested")->lazy_document();
+    const auto oid = nested.find("deep")->to_element();
+    EXPECT_EQ("deep", oid.name());
+    EXPECT_EQ(element_type::oid_element, oid.type());
+    EXPECT_EQ(read_json(R"({"deep": {"$oid": "507f1f77bcf86cd799439011"}, "n": [1, 2]})"s), nested.to_document());
+    EXPECT_THROW(id->lazy_document(), incompatible_type_conversion);
+    EXPECT_THROW(doc.to_document(), json_parse_error);
+
+    const auto whole = R"( {"a": {"b": [true, null]}, "c": 1.5} )"s;
+    EXPECT_EQ(read_json(whole), document(read_json_lazy(whole)));
+    EXPECT_EQ(read_json_lazy("{}"s).begin(), read_json_lazy("{}"s).end());
+    EXPECT_THROW(read_json_lazy("[]"s), json_parse_error);
+    EXPECT_THROW(read_json_lazy(R"({"a": "unclosed)"s).begin(), json_parse_error);
+    EXPECT_THROW(read_json_lazy(R"({"a": [{"b": 1}, "c": 2})"s).find("c"), json_parse_error);
+}
+
+TEST(JsonReaderTest, JsonLazyTest2) {
+    const auto position = [](auto&& fun) {
+        try {
+            fun();
+        } catch(json_parse_error& e) {
+            EXPECT_NE(nullptr, boost::get_error_info<detail::line_number>(e));
+            EXPECT_NE(nullptr, boost::get_error_info<detail::line_position>(e));
+            return std::make_tuple(*boost::get_error_info<detail::parse_error>(e),
+                                   *boost::get_error_info<detail::line_number>(e),
+                                   *boost::get_error_info<detail::line_position>(e));
+        }
+        ADD_FAILURE() << "expected json_parse_error";
+        return std::make_tuple(json_error_num::unexpected_token, size_t{0}, size_t{0});
+    };
+
+    // errors found scanning, or converting a member, are located in the input as a whole
+    const auto json = "{\"a\": 1,\n \"b\": [1, 2x],\n \"c\" 3}"s;
+    const auto doc = read_json_lazy(json);
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_token, 3u, 6u), position([&] { doc.find("c"); }));
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_token, 2u, 12u),
+              position([&] { doc.find("b")->to_element(); }));
+    EXPECT_EQ(std::make_tuple(json_error_num::invalid_root_element, 2u, 2u),
+              position([] { read_json_lazy("\n [1]"s); }));
+    const auto nested = "{\"a\": {\"b\": 1,\n \"c\": tyue}}"s;
+    EXPECT_EQ(std::make_tuple(json_error_num::unexpected_token, 2u, 7u),
+              position([&] { read_json_lazy(nested).begin()->lazy_document().find("c")->to_element(); }));
+
+    // members are converted where they are, as the only member of a document
+    const auto members = R"({"x\ty": {"$numberLong": "7"}, "z": [1, "\u00e9"]})"s;
+    const auto member = read_json_lazy(members).begin();
+    EXPECT_EQ("x\ty", member->name());
+    const auto elem = member->to_element();
+    EXPECT_EQ("x\ty", elem.name());
+    EXPECT_EQ(7, get<element_type::int64_element>(elem));
+    EXPECT_EQ(*read_json(R"({"z": [1, "\u00e9"]})"s).begin(), std::next(member)->to_element());
+}
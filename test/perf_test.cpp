@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include <jbson/json_reader.hpp>
+#include <jbson/json_lazy_reader.hpp>
 #include <jbson/json_writer.hpp>
 using namespace jbson;
 
@@ -65,6 +66,12 @@ TEST_F(PerfTest, ParseTest) {
     }
 }
 
+TEST_F(PerfTest, TrustedParseTest) {
+    for(size_t i = 0; i < kTrialCount; i++) {
+        ASSERT_NO_THROW(read_json<json_parse_policy::trusted>(json_));
+    }
+}
+
 #ifndef BOOST_NO_CXX11_HDR_CODECVT
 TEST_F(PerfTest, Utf16ParseTest) {
     std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> cvt{};
@@ -101,6 +108,68 @@ TEST_F(PerfTest, ParseToSetTest) {
     }
 }
 
+TEST_F(PerfTest, ParseIntoSetTest) {
+    for(size_t i = 0; i < kTrialCount; i++) {
+        auto set = read_json_set(json_);
+    }
+}
+
+TEST(NoFixPerfTest, TabularParseTest) {
+    // rows of an API result, each object repeating the keys of the last
+    std::string json = "[";
+    for(int i = 0; i < 10000; i++) {
+        if(i > 0)
+            json += ",";
+        json += R"({"id": )" + std::to_string(i) + R"(, "first_name": "Ada", "last_name": "Lovelace", )"
+                R"("email_address": "ada@example.com", "created_at": 1418000000, "is_active": true, )"
+                R"("account_balance": 12.5, "country_code": "GB"})";
+    }
+    json += "]";
+
+    detail::json_reader reader;
+    for(size_t i = 0; i < 200; i++) {
+        reader.parse(json);
+        ASSERT_EQ(10000, boost::distance(array(reader)));
+    }
+}
+
+TEST(NoFixPerfTest, ProjectedParseTest) {
+    // wide events, of which only a few members are kept
+    std::string json = "{";
+    for(int i = 0; i < 200; i++) {
+        if(i > 0)
+            json += ", ";
+        json += R"("field_)" + std::to_string(i) + R"(": )" +
+                (i % 2 ? R"("some string \"value\"")" : R"({"x": [1, 2, 3], "y": "z"})");
+    }
+    json += "}";
+
+    detail::json_reader reader;
+    reader.project({"field_0", "field_1", "field_50.x", "field_199"});
+    for(size_t i = 0; i < 20000; i++) {
+        reader.parse(json);
+        ASSERT_EQ(4, boost::distance(document(reader)));
+    }
+}
+
+TEST(NoFixPerfTest, LazyFindTest) {
+    // a large response of which only the fields around the payload are wanted
+    std::string json = R"({"status": "ok", "items": [)";
+    for(int i = 0; i < 10000; i++) {
+        if(i > 0)
+            json += ",";
+        json += R"({"id": )" + std::to_string(i) + R"(, "name": "item \"quoted\"", "tags": ["a", "b"], )"
+                R"("dims": {"w": 1.5, "h": [2, 3]}})";
+    }
+    json += R"(], "cursor": "abc123"})";
+
+    for(size_t i = 0; i < 200; i++) {
+        const auto doc = read_json_lazy(json);
+        ASSERT_EQ("ok", doc.find("status")->value<std::string>());
+        ASSERT_EQ("abc123", doc.find("cursor")->value<std::string>());
+    }
+}
+
 TEST(NoFixPerfTest, BuildTest) {
     for(int32_t i = 0; i < 1000000; i++) {
         auto build = builder("foo", builder("bar", builder("baz", array_builder(i)(2)(3))));